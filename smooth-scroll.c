@@ -25,12 +25,26 @@
 #include <fcntl.h>
 #include <dirent.h>
 #include <ctype.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <limits.h>
 #include <time.h>
 #include <getopt.h>
+#include <sched.h>
+#include <poll.h>
+#include <regex.h>
+#include <fnmatch.h>
 
 #include <sys/epoll.h>
 #include <sys/timerfd.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/inotify.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 
 #include <linux/input.h>
 #include <linux/uinput.h>
@@ -39,20 +53,71 @@
 
 /* ── Defaults ─────────────────────────────────────────────────────────── */
 
-#define DEFAULT_FRICTION 0.078     /* per-tick friction factor (250 Hz)    */
+#define DEFAULT_FRICTION 0.078     /* friction per reference tick (4 ms)   */
 #define DEFAULT_TICK_MS 4          /* timer interval (250 Hz)              */
 #define DEFAULT_LOW_RATE 5.0       /* events/sec: below = no dampening     */
 #define DEFAULT_HIGH_RATE 30.0     /* events/sec: above = max dampening    */
 #define DEFAULT_MIN_SCALE 0.3      /* scale factor at high input rate      */
 #define DEFAULT_STOP_THRESHOLD 0.5 /* velocity below which scrolling stops */
 #define DEFAULT_MULTIPLIER 0.5     /* global scroll distance multiplier    */
+#define DEFAULT_RT_PRIORITY 50     /* SCHED_FIFO priority for --realtime   */
+#define DEFAULT_RATE_RING_SIZE 128 /* input timestamps kept per axis       */
+#define DEFAULT_RATE_WINDOW_MS 300 /* input-rate tracking window           */
+#define DEFAULT_CURVE "sqrt"       /* dampening curve between the rates    */
+#define DEFAULT_SPRING_STIFFNESS 900.0 /* 1/s^2: a notch settles in ~220 ms */
+#define DEFAULT_SPRING_MS 300      /* longest a notch may take to settle   */
+#define DEFAULT_REVERSAL_DAMP 0.25 /* glide kept by --reversal damp        */
+
+/*
+ * Friction is specified per reference tick and applied over the real
+ * elapsed time, so --tick-ms only changes the output cadence and not the
+ * distance a gesture travels.
+ */
+#define FRICTION_REF_NS (DEFAULT_TICK_MS * 1000000LL)
 
 /* Hi-res scroll unit: one REL_WHEEL tick = 120 hi-res units (kernel ABI). */
 #define HIRES_PER_TICK 120
 
-/* Ring buffer for input-rate tracking: stores timestamps over a window. */
-#define RATE_RING_SIZE 128
-#define RATE_WINDOW_NS 300000000LL /* 300 ms */
+/*
+ * Tickless scheduling: wake slightly after the computed due time so
+ * floating-point rounding never lands a wakeup just short of the unit.
+ */
+#define TICKLESS_SLACK_NS 20000LL /* 20 us */
+
+/*
+ * Refresh-locked scheduling: gains of the software PLL that learns how
+ * early the timer must be armed so wakeups land on the frame boundary.
+ */
+#define PLL_KP 0.25   /* proportional gain on the per-frame phase error */
+#define PLL_KI 0.0625 /* integral gain: tracks the mean wakeup latency  */
+
+/*
+ * Longest wait for udev to process a new virtual device before the
+ * source is grabbed anyway.
+ */
+#define UDEV_READY_TIMEOUT_MS 2000
+
+/* Settle delay for a virtual device whose udev entry cannot be found. */
+#define UDEV_SETTLE_MS 200
+
+/* Stack pre-faulted by --realtime so the loop never page-faults on it. */
+#define RT_STACK_PREFAULT (256 * 1024)
+
+/* Match rule used when no --match is given: the VM pointer devices. */
+#define DEFAULT_MATCH_RULE "name=spice|qemu|virtio,caps=REL_WHEEL"
+
+/* Source devices smoothed at once, each with its own virtual device. */
+#define MAX_DEVICES 16
+
+/*
+ * A lost auto-detected source that has not come back after this long is
+ * dropped, together with its virtual device, at the next /dev/input
+ * change.
+ */
+#define DEVICE_LINGER_NS (30 * 1000000000LL)
+
+/* Control socket connections served at once. */
+#define CONTROL_MAX_CLIENTS 4
 
 /* ── Global state for signal handler ──────────────────────────────────── */
 
@@ -65,28 +130,245 @@ static void signal_handler(int sig)
     g_running = 0;
 }
 
+/* ── Fixed-point arithmetic ───────────────────────────────────────────── */
+
+/*
+ * --fixed-point runs the friction model, the dampening scale, the input
+ * rate and the tickless due time in integers: distances are Q32.32
+ * hi-res units, rates and scale factors Q16.16.  Only the tables are
+ * built with libm (pow() for the curve, the rounding of 1 - friction for
+ * the decay) when the configuration is loaded; the per-event and
+ * per-tick arithmetic is integer.  With the same tables, the output then
+ * depends only on the event and tick timestamps.
+ */
+#define Q32_ONE (1LL << 32)
+#define Q16_ONE (1LL << 16)
+
+/*
+ * The decay factor (1 - friction)^(dt / 4 ms) is looked up with dt in
+ * 1/4096ths of the reference tick (~1 us), split into 6-bit chunks: one
+ * table per chunk, so a step costs five multiplies and reaches ~17 min.
+ */
+#define FX_DECAY_REF_BIT 12
+#define FX_DECAY_CHUNK_BITS 6
+#define FX_DECAY_CHUNKS 5
+#define FX_DECAY_BITS (FX_DECAY_CHUNKS * FX_DECAY_CHUNK_BITS)
+
+/* a * f / 2^shift, truncated towards zero, for f < 2^32, shift <= 32. */
+static int64_t fx_mul(int64_t a, uint64_t f, int shift)
+{
+    uint64_t m = a < 0 ? -(uint64_t)a : (uint64_t)a;
+    uint64_t r = (((m >> 32) * f) << (32 - shift)) +
+                 (((m & 0xffffffffu) * f) >> shift);
+    return a < 0 ? -(int64_t)r : (int64_t)r;
+}
+
+/* floor(sqrt(x)). */
+static uint64_t fx_isqrt(uint64_t x)
+{
+    uint64_t r = 0;
+    for (uint64_t bit = 1ULL << 62; bit; bit >>= 2)
+    {
+        if (x >= r + bit)
+        {
+            x -= r + bit;
+            r = (r >> 1) + bit;
+        }
+        else
+            r >>= 1;
+    }
+    return r;
+}
+
+typedef uint32_t fx_decay_table[FX_DECAY_CHUNKS][1 << FX_DECAY_CHUNK_BITS];
+
+/*
+ * Fill t with the Q0.32 decay factors for friction; 1.0 is stored as
+ * 2^32 - 1.  Only the rounding of 1 - friction touches floating point:
+ * the powers (1 - friction)^(2^k / 4096) come from integer square roots
+ * and squares, and each entry is a product of them.
+ */
+static void fx_decay_build(fx_decay_table t, double friction)
+{
+    uint32_t pow2[FX_DECAY_BITS];
+
+    pow2[FX_DECAY_REF_BIT] =
+        (uint32_t)((1.0 - friction) * 4294967296.0 + 0.5);
+    for (int k = FX_DECAY_REF_BIT; k > 0; k--)
+        pow2[k - 1] = (uint32_t)fx_isqrt((uint64_t)pow2[k] << 32);
+    for (int k = FX_DECAY_REF_BIT + 1; k < FX_DECAY_BITS; k++)
+        pow2[k] = (uint32_t)(((uint64_t)pow2[k - 1] * pow2[k - 1]) >> 32);
+
+    for (int c = 0; c < FX_DECAY_CHUNKS; c++)
+    {
+        t[c][0] = UINT32_MAX;
+        for (int j = 1; j < 1 << FX_DECAY_CHUNK_BITS; j++)
+        {
+            int low = 0;
+            while (!(j & (1 << low)))
+                low++;
+            t[c][j] = (uint32_t)(((uint64_t)t[c][j & (j - 1)] *
+                                  pow2[c * FX_DECAY_CHUNK_BITS + low]) >>
+                                 32);
+        }
+    }
+}
+
+/* The Q0.32 decay factor over n 1/4096ths of the reference tick. */
+static uint64_t fx_decay_steps(const fx_decay_table t, uint64_t n)
+{
+    if (n >> FX_DECAY_BITS)
+        return 0;
+
+    uint64_t f = t[0][n & ((1 << FX_DECAY_CHUNK_BITS) - 1)];
+    for (int c = 1; c < FX_DECAY_CHUNKS; c++)
+    {
+        n >>= FX_DECAY_CHUNK_BITS;
+        f = (f * t[c][n & ((1 << FX_DECAY_CHUNK_BITS) - 1)]) >> 32;
+    }
+    return f;
+}
+
+/* The Q0.32 decay factor over dt nanoseconds. */
+static uint64_t fx_decay(const fx_decay_table t, int64_t dt)
+{
+    return fx_decay_steps(t, (uint64_t)dt * (1u << FX_DECAY_REF_BIT) /
+                                 (uint64_t)FRICTION_REF_NS);
+}
+
 /* ── Configuration ────────────────────────────────────────────────────── */
 
-struct config
+/* How the emission timer is scheduled while an axis is gliding. */
+enum scheduler_mode
 {
-    double friction;         /* per-tick friction factor (0.01-0.2)  */
-    int tick_ms;             /* timer interval in milliseconds       */
+    SCHEDULER_FIXED,    /* wake on every tick of the --tick-ms grid       */
+    SCHEDULER_TICKLESS, /* wake only when the next hi-res unit is due     */
+    SCHEDULER_REFRESH,  /* one coalesced frame per display refresh        */
+};
+
+static const char *const scheduler_names[] = {"fixed", "tickless", "refresh"};
+
+/* How an axis travels the distance its input adds. */
+enum physics_model
+{
+    MODEL_FRICTION, /* impulse, then exponential decay                  */
+    MODEL_SPRING,   /* critically damped spring towards the target      */
+};
+
+static const char *const model_names[] = {"friction", "spring"};
+
+/* What input against the direction of a glide does to it. */
+enum reversal_policy
+{
+    REVERSAL_ADD,    /* the opposite impulse is simply added            */
+    REVERSAL_CANCEL, /* the glide stops, the new input starts afresh    */
+    REVERSAL_DAMP,   /* the glide is scaled by reversal_damp first      */
+};
+
+static const char *const reversal_names[] = {"add", "cancel", "damp"};
+
+/* Physics settings, one block per axis. */
+struct axis_params
+{
+    enum physics_model model; /* friction decay or spring            */
+    double friction;         /* friction per 4 ms (0.01-0.2)         */
+    double spring_stiffness; /* spring constant per unit mass, 1/s^2 */
+    int spring_ms;           /* spring: settle deadline after input  */
+    enum reversal_policy reversal; /* input against a glide          */
+    double reversal_damp;    /* glide kept on reversal (damp)        */
     double low_rate;         /* events/sec threshold: no dampening   */
     double high_rate;        /* events/sec threshold: max dampening  */
     double min_scale;        /* scale factor at >= high_rate         */
+    char curve[256];         /* dampening curve spec, see curve_compile */
     double stop_threshold;   /* velocity below which scrolling stops */
-    double multiplier;       /* global scroll distance multiplier    */
+    double multiplier;       /* scroll distance multiplier           */
+    double decay_per_ns;     /* ln(1 - friction) per ns, derived     */
+    double spring_omega_per_ns; /* sqrt(stiffness) per ns, derived   */
+
+    /* --fixed-point, derived */
+    int fixed;               /* integer friction model on this axis  */
+    fx_decay_table decay_q;  /* see fx_decay_build()                 */
+    int64_t stop_q;          /* stop_threshold in Q32.32             */
+    int64_t low_rate_q;      /* Q16.16 events/sec                    */
+    int64_t high_rate_q;     /* Q16.16 events/sec                    */
+    int64_t min_scale_q;     /* Q16.16                               */
+    int64_t multiplier_q;    /* Q16.16                               */
+    int64_t reversal_damp_q; /* Q16.16                               */
+};
+
+enum axis_id
+{
+    AXIS_VERT,
+    AXIS_HORIZ,
+    AXIS_COUNT,
+};
+
+struct config
+{
+    struct axis_params axis[AXIS_COUNT]; /* physics, by enum axis_id  */
+    uint64_t h_set;          /* params[] set for the horizontal axis */
+    int tick_ms;             /* timer interval in milliseconds       */
+    enum scheduler_mode scheduler; /* fixed tick, tickless or refresh   */
+    double refresh_hz;       /* display refresh rate, 0 = not locked */
+    int phase_offset_us;     /* frame phase on CLOCK_MONOTONIC       */
+    int rate_ring_size;      /* input timestamps kept per axis       */
+    int rate_window_ms;      /* input-rate tracking window           */
+    int fixed_point;         /* integer physics for the friction model */
     int verbose;             /* debug printing                       */
-    const char *device_path; /* NULL = auto-detect                  */
+    int realtime;            /* SCHED_FIFO, mlockall, pinning, slack */
+    int rt_priority;         /* SCHED_FIFO priority (1-99)           */
+    int rt_cpu;              /* CPU to pin to, -1 = no pinning       */
+    char control_path[108];  /* --control-socket (sun_path), "" = none */
+    const char *config_path; /* --config file, NULL = none           */
+    char device_paths[MAX_DEVICES][280]; /* explicit DEVICE_PATHs    */
+    int ndevice_paths;       /* 0 = auto-detect every match          */
+    struct match_rule *rules; /* auto-detection rules, by priority   */
+    int nrules;
+    unsigned int match_types; /* EV_* types whose caps rules test    */
 };
 
-/* ── Input-rate ring buffer ───────────────────────────────────────────── */
+static void config_defaults(struct config *cfg)
+{
+    struct axis_params *ap = &cfg->axis[AXIS_VERT];
+
+    memset(cfg, 0, sizeof(*cfg));
+    ap->model = MODEL_FRICTION;
+    ap->friction = DEFAULT_FRICTION;
+    ap->spring_stiffness = DEFAULT_SPRING_STIFFNESS;
+    ap->spring_ms = DEFAULT_SPRING_MS;
+    ap->reversal = REVERSAL_ADD;
+    ap->reversal_damp = DEFAULT_REVERSAL_DAMP;
+    ap->low_rate = DEFAULT_LOW_RATE;
+    ap->high_rate = DEFAULT_HIGH_RATE;
+    ap->min_scale = DEFAULT_MIN_SCALE;
+    strcpy(ap->curve, DEFAULT_CURVE);
+    ap->stop_threshold = DEFAULT_STOP_THRESHOLD;
+    ap->multiplier = DEFAULT_MULTIPLIER;
+    cfg->axis[AXIS_HORIZ] = *ap;
+    cfg->tick_ms = DEFAULT_TICK_MS;
+    cfg->scheduler = SCHEDULER_FIXED;
+    cfg->rate_ring_size = DEFAULT_RATE_RING_SIZE;
+    cfg->rate_window_ms = DEFAULT_RATE_WINDOW_MS;
+    cfg->rt_priority = DEFAULT_RT_PRIORITY;
+    cfg->rt_cpu = -1;
+}
 
+/* ── Input-rate sliding window ────────────────────────────────────────── */
+
+/*
+ * Timestamps of recent scroll events, oldest at tail.  Entries are
+ * evicted as they age out of the window (or when the ring is full), so
+ * count and the oldest timestamp are always current and rate_record() +
+ * rate_compute() cost amortized O(1).
+ */
 struct rate_tracker
 {
-    int64_t timestamps[RATE_RING_SIZE]; /* nanosecond timestamps */
-    int head;
-    int count;
+    int64_t *timestamps; /* nanosecond timestamps, size entries  */
+    int size;            /* ring capacity                        */
+    int head;            /* next slot to write                   */
+    int tail;            /* oldest entry still in the window     */
+    int count;           /* entries from tail up to head         */
+    int64_t window_ns;   /* tracking window                      */
 };
 
 static int64_t now_ns(void)
@@ -96,249 +378,1021 @@ static int64_t now_ns(void)
     return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
 }
 
+/* Kernel timestamp of an input event (CLOCK_MONOTONIC once EVIOCSCLOCKID). */
+static int64_t event_time_ns(const struct input_event *ev)
+{
+    return (int64_t)ev->input_event_sec * 1000000000LL +
+           (int64_t)ev->input_event_usec * 1000LL;
+}
+
+static int rate_init(struct rate_tracker *rt, int size, int64_t window_ns)
+{
+    memset(rt, 0, sizeof(*rt));
+    rt->timestamps = calloc((size_t)size, sizeof(*rt->timestamps));
+    if (!rt->timestamps)
+        return -1;
+    rt->size = size;
+    rt->window_ns = window_ns;
+    return 0;
+}
+
+static void rate_free(struct rate_tracker *rt)
+{
+    free(rt->timestamps);
+    rt->timestamps = NULL;
+}
+
+/*
+ * Change the ring capacity and window at runtime.  The newest entries
+ * that fit are kept, so the measured rate carries over.
+ */
+static int rate_resize(struct rate_tracker *rt, int size, int64_t window_ns)
+{
+    rt->window_ns = window_ns;
+    if (size == rt->size)
+        return 0;
+
+    int64_t *ts = calloc((size_t)size, sizeof(*ts));
+    if (!ts)
+        return -1;
+
+    int keep = rt->count < size ? rt->count : size;
+    for (int i = 0; i < keep; i++)
+        ts[i] = rt->timestamps[(rt->tail + rt->count - keep + i) % rt->size];
+
+    free(rt->timestamps);
+    rt->timestamps = ts;
+    rt->size = size;
+    rt->tail = 0;
+    rt->count = keep;
+    rt->head = keep % size;
+    return 0;
+}
+
+/* Drop the oldest entry. */
+static void rate_pop(struct rate_tracker *rt)
+{
+    if (++rt->tail == rt->size)
+        rt->tail = 0;
+    rt->count--;
+}
+
+/* Evict entries that have aged out of the window. */
+static void rate_expire(struct rate_tracker *rt, int64_t now)
+{
+    int64_t cutoff = now - rt->window_ns;
+    while (rt->count > 0 && rt->timestamps[rt->tail] < cutoff)
+        rate_pop(rt);
+}
+
 static void rate_record(struct rate_tracker *rt, int64_t ts)
 {
+    rate_expire(rt, ts);
+    if (rt->count == rt->size)
+        rate_pop(rt);
+
     rt->timestamps[rt->head] = ts;
-    rt->head = (rt->head + 1) % RATE_RING_SIZE;
-    if (rt->count < RATE_RING_SIZE)
-        rt->count++;
+    if (++rt->head == rt->size)
+        rt->head = 0;
+    rt->count++;
 }
 
 /*
- * Compute events-per-second from the ring buffer, considering only
- * events within the tracking window.
+ * Compute events-per-second over the events still inside the tracking
+ * window.
  */
-static double rate_compute(const struct rate_tracker *rt, int64_t now)
+static double rate_compute(struct rate_tracker *rt, int64_t now)
 {
-    int64_t cutoff = now - RATE_WINDOW_NS;
-    int n = 0;
-    int64_t oldest = now;
-
-    for (int i = 0; i < rt->count; i++)
-    {
-        int idx = (rt->head - 1 - i + RATE_RING_SIZE) % RATE_RING_SIZE;
-        if (rt->timestamps[idx] >= cutoff)
-        {
-            n++;
-            if (rt->timestamps[idx] < oldest)
-                oldest = rt->timestamps[idx];
-        }
-    }
+    rate_expire(rt, now);
 
+    int n = rt->count;
     if (n < 2)
         return 0.0;
 
-    double window_sec = (double)(now - oldest) / 1e9;
+    double window_sec = (double)(now - rt->timestamps[rt->tail]) / 1e9;
     if (window_sec < 1e-6)
         return 0.0;
 
     return (double)n / window_sec;
 }
 
+/* rate_compute() in Q16.16 events per second, for --fixed-point. */
+static int64_t rate_compute_q(struct rate_tracker *rt, int64_t now)
+{
+    rate_expire(rt, now);
+
+    int n = rt->count;
+    if (n < 2)
+        return 0;
+
+    int64_t window_ns = now - rt->timestamps[rt->tail];
+    if (window_ns < 1000)
+        return 0;
+
+    return ((int64_t)n << 16) * 1000000000LL / window_ns;
+}
+
 /* ── Velocity state (one per axis) ────────────────────────────────────── */
 
 struct axis_state
 {
-    double velocity;
+    double velocity;     /* distance still to travel, in hi-res units   */
+    double spring_speed; /* spring: d(velocity)/dt per ns               */
     double emit_accum; /* sub-pixel accumulator for fractional hi-res units */
+    int64_t velocity_q;   /* --fixed-point: velocity in Q32.32; the double  */
+    int64_t accum_q;      /* fields above then stay 0, and these otherwise  */
     int lowres_accum;  /* hi-res units accumulated towards next REL_WHEEL   */
+    int64_t last_step_ns; /* time of the last integration step             */
+    int pending_input;    /* input since the last frame (refresh mode)      */
+    int64_t input_ns;     /* oldest input not yet in the output, 0 = none   */
+    int64_t last_input_ns; /* latest input, for the spring deadline         */
+    int64_t gesture_ns;   /* when the axis left rest, 0 = at rest           */
+    int target_sign;      /* sign of the distance left after the last input */
+    double overshoot;     /* furthest travelled past the target, this glide */
+    int emit_dir;         /* sign of the last hi-res unit emitted           */
+    int64_t reversal_ns;  /* input against the glide not yet in the output  */
+    int reversal_dir;     /* direction of that input                        */
     struct rate_tracker rate;
 };
 
 /* ── Non-linear dampening ─────────────────────────────────────────────── */
 
 /*
- * Given the current input rate (events/sec), compute a scale factor in
- * [min_scale, 1.0].  Below low_rate → 1.0 (full responsiveness).
- * Above high_rate → min_scale (maximum dampening).  Between: sqrt interp.
+ * The dampening curve maps where the input rate lies between low_rate and
+ * high_rate, t in [0, 1], to how much of the (1 - min_scale) dampening
+ * applies, also in [0, 1]:
+ *
+ *   sqrt                 t^0.5, the default
+ *   linear               t
+ *   power:K              t^K
+ *   piecewise:T:D,...    straight lines through the points
+ *   cubic:T:D,...        a monotone cubic through the points, which never
+ *                        overshoots them
+ *
+ * Points need increasing T; the curve is flat before the first and after
+ * the last.  Whatever the curve, it is compiled once into a table that
+ * the scroll path interpolates, so none costs more per event than another.
  */
-static double compute_scale(double input_rate, const struct config *cfg)
-{
-    if (input_rate <= cfg->low_rate)
-        return 1.0;
-    if (input_rate >= cfg->high_rate)
-        return cfg->min_scale;
-
-    double t = (input_rate - cfg->low_rate) / (cfg->high_rate - cfg->low_rate);
-    return 1.0 - (1.0 - cfg->min_scale) * sqrt(t);
-}
+#define CURVE_LUT_SIZE 1024 /* intervals: sqrt is off by < 0.008 near 0 */
+#define CURVE_MAX_POINTS 16
 
-/* ── Case-insensitive substring search ────────────────────────────────── */
+struct curve
+{
+    double lut[CURVE_LUT_SIZE + 1]; /* dampening at t = i / CURVE_LUT_SIZE */
+    int32_t lut_q[CURVE_LUT_SIZE + 1]; /* the same in Q16.16             */
+};
 
-static int strcasestr_any(const char *haystack, const char *const needles[],
-                          int n)
+/* Parse "T:D,T:D,..." into x and y.  Returns the number of points. */
+static int curve_points(const char *list, double *x, double *y, char *err,
+                        size_t errlen)
 {
-    for (int i = 0; i < n; i++)
+    const char *s = list;
+    char *end;
+    int n = 0;
+
+    while (*s)
     {
-        if (strcasestr(haystack, needles[i]) != NULL)
-            return 1;
+        if (n == CURVE_MAX_POINTS)
+        {
+            snprintf(err, errlen, "curve: more than %d points",
+                     CURVE_MAX_POINTS);
+            return -1;
+        }
+        x[n] = strtod(s, &end);
+        if (end == s || *end != ':')
+            break;
+        s = end + 1;
+        y[n] = strtod(s, &end);
+        if (end == s || (*end && *end != ',') || (*end && !end[1]))
+            break;
+        if (x[n] < 0.0 || x[n] > 1.0 || y[n] < 0.0 || y[n] > 1.0 ||
+            (n > 0 && x[n] <= x[n - 1]))
+        {
+            snprintf(err, errlen,
+                     "curve: T must increase, with T and D in [0, 1]");
+            return -1;
+        }
+        n++;
+        s = *end ? end + 1 : end;
     }
-    return 0;
+    if (*s || n < 2)
+    {
+        snprintf(err, errlen, "curve: expected two or more T:D points, "
+                              "got '%s'", list);
+        return -1;
+    }
+    return n;
 }
 
-/* ── Device auto-detection ────────────────────────────────────────────── */
-
 /*
- * Scan /dev/input/event* for a device whose name contains "spice", "qemu",
- * or "virtio" (case-insensitive) and that supports REL_WHEEL.
- * Returns a newly-allocated path string or NULL.
+ * Fritsch-Carlson tangents: a cubic Hermite through the points with these
+ * tangents is monotone wherever the points are.
  */
-static char *find_scroll_device(void)
+static void curve_tangents(const double *x, const double *y, int n,
+                           double *m)
 {
-    static const char *keywords[] = {"spice", "qemu", "virtio"};
-    DIR *dir = opendir("/dev/input");
-    if (!dir)
-    {
-        perror("opendir /dev/input");
-        return NULL;
-    }
+    double d[CURVE_MAX_POINTS] = {0};
+    for (int k = 0; k < n - 1; k++)
+        d[k] = (y[k + 1] - y[k]) / (x[k + 1] - x[k]);
 
-    struct dirent *ent;
-    char path[280];
-    char name[256];
+    m[0] = d[0];
+    m[n - 1] = d[n - 2];
+    for (int k = 1; k < n - 1; k++)
+        m[k] = d[k - 1] * d[k] <= 0.0 ? 0.0 : (d[k - 1] + d[k]) / 2.0;
 
-    while ((ent = readdir(dir)) != NULL)
+    for (int k = 0; k < n - 1; k++)
     {
-        if (strncmp(ent->d_name, "event", 5) != 0)
-            continue;
-
-        snprintf(path, sizeof(path), "/dev/input/%s", ent->d_name);
-
-        int fd = open(path, O_RDONLY | O_NONBLOCK);
-        if (fd < 0)
-            continue;
-
-        /* Read device name. */
-        memset(name, 0, sizeof(name));
-        if (ioctl(fd, EVIOCGNAME(sizeof(name) - 1), name) < 0)
+        if (d[k] == 0.0)
         {
-            close(fd);
+            m[k] = m[k + 1] = 0.0;
             continue;
         }
-
-        /* Check name matches one of the VM keywords. */
-        if (!strcasestr_any(name, keywords, 3))
+        double a = m[k] / d[k], b = m[k + 1] / d[k];
+        double h = a * a + b * b;
+        if (h > 9.0)
         {
-            close(fd);
-            continue;
+            double tau = 3.0 / sqrt(h);
+            m[k] = tau * a * d[k];
+            m[k + 1] = tau * b * d[k];
         }
+    }
+}
 
-        /* Check for REL_WHEEL capability. */
-        unsigned long rel_bits[((REL_MAX + 1) + 8 * sizeof(unsigned long) - 1) /
-                               (8 * sizeof(unsigned long))];
-        memset(rel_bits, 0, sizeof(rel_bits));
+static double curve_points_eval(const double *x, const double *y,
+                                const double *m, int n, double t)
+{
+    if (t <= x[0])
+        return y[0];
+    if (t >= x[n - 1])
+        return y[n - 1];
+
+    int k = 0;
+    while (t > x[k + 1])
+        k++;
+    double h = x[k + 1] - x[k];
+    double s = (t - x[k]) / h;
+    if (!m)
+        return y[k] + (y[k + 1] - y[k]) * s;
+
+    double s2 = s * s, s3 = s2 * s;
+    return (2.0 * s3 - 3.0 * s2 + 1.0) * y[k] + (s3 - 2.0 * s2 + s) * h * m[k] +
+           (3.0 * s2 - 2.0 * s3) * y[k + 1] + (s3 - s2) * h * m[k + 1];
+}
 
-        if (ioctl(fd, EVIOCGBIT(EV_REL, sizeof(rel_bits)), rel_bits) < 0)
+/* Compile spec into c.  Returns -1 with the reason in err. */
+static int curve_compile(struct curve *c, const char *spec, char *err,
+                         size_t errlen)
+{
+    double x[CURVE_MAX_POINTS], y[CURVE_MAX_POINTS], m[CURVE_MAX_POINTS];
+    double k = 0.0;
+    int n = 0, cubic = 0;
+    char *end;
+
+    if (strcmp(spec, "sqrt") == 0)
+        k = 0.5;
+    else if (strcmp(spec, "linear") == 0)
+        k = 1.0;
+    else if (strncmp(spec, "power:", 6) == 0)
+    {
+        k = strtod(spec + 6, &end);
+        if (end == spec + 6 || *end || !(k > 0.0 && k <= 100.0))
         {
-            close(fd);
-            continue;
+            snprintf(err, errlen, "curve: power:K needs 0 < K <= 100");
+            return -1;
         }
+    }
+    else if (strncmp(spec, "piecewise:", 10) == 0)
+        n = curve_points(spec + 10, x, y, err, errlen);
+    else if (strncmp(spec, "cubic:", 6) == 0)
+    {
+        cubic = 1;
+        n = curve_points(spec + 6, x, y, err, errlen);
+    }
+    else
+    {
+        snprintf(err, errlen, "curve: unknown curve '%s' (sqrt, linear, "
+                              "power:K, piecewise:T:D,..., cubic:T:D,...)",
+                 spec);
+        return -1;
+    }
+    if (n < 0)
+        return -1;
 
-        /* Test if REL_WHEEL bit is set. */
-        int has_wheel = (rel_bits[REL_WHEEL / (8 * sizeof(unsigned long))] >>
-                         (REL_WHEEL % (8 * sizeof(unsigned long)))) &
-                        1;
-        close(fd);
-
-        if (has_wheel)
-        {
-            fprintf(stderr, "Auto-detected device: %s (%s)\n", path, name);
-            closedir(dir);
-            return strdup(path);
-        }
+    if (cubic)
+        curve_tangents(x, y, n, m);
+    for (int i = 0; i <= CURVE_LUT_SIZE; i++)
+    {
+        double t = (double)i / CURVE_LUT_SIZE;
+        double d = n ? curve_points_eval(x, y, cubic ? m : NULL, n, t)
+                     : pow(t, k);
+        c->lut[i] = d < 0.0 ? 0.0 : (d > 1.0 ? 1.0 : d);
+        c->lut_q[i] = (int32_t)(c->lut[i] * (double)Q16_ONE + 0.5);
     }
+    return 0;
+}
 
-    closedir(dir);
-    return NULL;
+/* Dampening at t in [0, 1], interpolated from the table. */
+static double curve_eval(const struct curve *c, double t)
+{
+    double x = t * CURVE_LUT_SIZE;
+    int i = (int)x;
+    if (i >= CURVE_LUT_SIZE)
+        i = CURVE_LUT_SIZE - 1;
+    return c->lut[i] + (c->lut[i + 1] - c->lut[i]) * (x - (double)i);
 }
 
-/* ── uinput device creation ───────────────────────────────────────────── */
+/*
+ * Given the current input rate (events/sec), compute a scale factor in
+ * [min_scale, 1.0].  Below low_rate → 1.0 (full responsiveness).
+ * Above high_rate → min_scale (maximum dampening).  Between: the curve.
+ */
+static double compute_scale(double input_rate, const struct axis_params *ap,
+                            const struct curve *curve)
+{
+    if (input_rate <= ap->low_rate)
+        return 1.0;
+    if (input_rate >= ap->high_rate)
+        return ap->min_scale;
+
+    double t = (input_rate - ap->low_rate) / (ap->high_rate - ap->low_rate);
+    return 1.0 - (1.0 - ap->min_scale) * curve_eval(curve, t);
+}
+
+/* compute_scale() in Q16.16, for --fixed-point. */
+static int64_t compute_scale_q(int64_t rate_q, const struct axis_params *ap,
+                               const struct curve *curve)
+{
+    if (rate_q <= ap->low_rate_q)
+        return Q16_ONE;
+    if (rate_q >= ap->high_rate_q)
+        return ap->min_scale_q;
+
+    int64_t t = (rate_q - ap->low_rate_q) * Q16_ONE /
+                (ap->high_rate_q - ap->low_rate_q);
+    int64_t x = t * CURVE_LUT_SIZE;
+    int64_t i = x >> 16;
+    if (i >= CURVE_LUT_SIZE)
+        i = CURVE_LUT_SIZE - 1;
+    int64_t d = curve->lut_q[i] + (curve->lut_q[i + 1] - curve->lut_q[i]) *
+                                      (x - (i << 16)) / Q16_ONE;
+    return Q16_ONE - (Q16_ONE - ap->min_scale_q) * d / Q16_ONE;
+}
+
+/* ── Bitmaps ──────────────────────────────────────────────────────────── */
+
+#define LONG_BITS (8 * sizeof(unsigned long))
+#define NLONGS(n) (((n) + LONG_BITS - 1) / LONG_BITS)
+
+static int test_bit(const unsigned long *bits, unsigned int bit)
+{
+    return (bits[bit / LONG_BITS] >> (bit % LONG_BITS)) & 1;
+}
+
+/* ── Device match rules ───────────────────────────────────────────────── */
 
 /*
- * Create a uinput virtual device that mirrors all capabilities of the
- * source libevdev device, plus REL_WHEEL_HI_RES and REL_HWHEEL_HI_RES.
- * Returns the uinput fd (>= 0) or -1 on error.
+ * A --match rule is a comma-separated list of conditions, all of which
+ * must hold:
+ *
+ *   name=REGEX      extended regex on the device name, case-insensitive
+ *                   (it cannot contain a comma)
+ *   vendor=HEX      USB-style vendor id
+ *   product=HEX     product id
+ *   bus=BUS         usb, bluetooth, virtual, i8042, i2c, host or hex id
+ *   phys=GLOB       shell pattern on the phys path
+ *   caps=CODE+...   required event codes, e.g. REL_WHEEL+BTN_LEFT
+ *   priority=INT    rules are tried highest first (default 0)
+ *   ignore          a matching device is never grabbed
+ *
+ * The first rule in priority order that matches decides.  Everything is
+ * checked against sysfs, so no candidate node is ever opened.
  */
-static int create_uinput_device(struct libevdev *source_dev)
+#define MATCH_MAX_CAPS 16
+
+struct match_rule
 {
-    int uifd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
-    if (uifd < 0)
+    char *text;         /* the rule as given, for messages  */
+    int has_name;
+    regex_t name;
+    int vendor;         /* -1 = any                          */
+    int product;        /* -1 = any                          */
+    int bustype;        /* -1 = any                          */
+    char *phys;         /* fnmatch pattern, NULL = any       */
+    int ncaps;
+    struct
     {
-        perror("open /dev/uinput");
-        return -1;
-    }
+        unsigned short type, code;
+    } caps[MATCH_MAX_CAPS];
+    int priority;
+    int ignore;
+};
 
-    struct uinput_setup setup;
-    memset(&setup, 0, sizeof(setup));
+static int match_parse_hex(const char *s)
+{
+    char *end;
+    long v = strtol(s, &end, 16);
+    return (*s && !*end && v >= 0 && v <= 0xffff) ? (int)v : -1;
+}
 
-    /* Name the virtual device "<original> (smooth scroll)". */
-    const char *src_name = libevdev_get_name(source_dev);
-    snprintf(setup.name, UINPUT_MAX_NAME_SIZE, "%s (smooth scroll)",
-             src_name ? src_name : "Unknown");
-    setup.id.bustype = libevdev_get_id_bustype(source_dev);
-    setup.id.vendor = libevdev_get_id_vendor(source_dev);
-    setup.id.product = libevdev_get_id_product(source_dev);
-    setup.id.version = libevdev_get_id_version(source_dev);
+static int match_parse_priority(const char *s, int *priority)
+{
+    char *end;
+    errno = 0;
+    long v = strtol(s, &end, 10);
+    if (!*s || *end || errno || v < INT_MIN || v > INT_MAX)
+        return -1;
+    *priority = (int)v;
+    return 0;
+}
 
-    /*
-     * Mirror every event type and code from the source device.
-     * We iterate all known event types and their codes.
-     */
-    for (unsigned int type = 0; type <= EV_MAX; type++)
+static int match_parse_bus(const char *s)
+{
+    static const struct
     {
-        if (!libevdev_has_event_type(source_dev, type))
-            continue;
+        const char *name;
+        int bus;
+    } buses[] = {
+        {"usb", BUS_USB},         {"bluetooth", BUS_BLUETOOTH},
+        {"virtual", BUS_VIRTUAL}, {"i8042", BUS_I8042},
+        {"i2c", BUS_I2C},         {"host", BUS_HOST},
+    };
 
-        if (ioctl(uifd, UI_SET_EVBIT, type) < 0)
-        {
-            fprintf(stderr, "UI_SET_EVBIT %u: %s\n", type, strerror(errno));
-            /* non-fatal: some types may not be supported by uinput */
-            continue;
-        }
+    for (size_t i = 0; i < sizeof(buses) / sizeof(buses[0]); i++)
+        if (strcasecmp(s, buses[i].name) == 0)
+            return buses[i].bus;
+    return match_parse_hex(s);
+}
 
-        int max_code = libevdev_event_type_get_max(type);
-        if (max_code < 0)
-            continue;
+/* Event type of a code name, from its prefix; -1 if unknown. */
+static int match_code_type(const char *name)
+{
+    static const struct
+    {
+        const char *prefix;
+        int type;
+    } prefixes[] = {
+        {"KEY_", EV_KEY}, {"BTN_", EV_KEY}, {"REL_", EV_REL},
+        {"ABS_", EV_ABS}, {"MSC_", EV_MSC}, {"SW_", EV_SW},
+        {"LED_", EV_LED}, {"SND_", EV_SND},
+    };
 
-        for (int code = 0; code <= max_code; code++)
+    for (size_t i = 0; i < sizeof(prefixes) / sizeof(prefixes[0]); i++)
+        if (strncmp(name, prefixes[i].prefix, strlen(prefixes[i].prefix)) == 0)
+            return prefixes[i].type;
+    return -1;
+}
+
+static int match_parse_caps(struct match_rule *r, char *list)
+{
+    char *save = NULL;
+    for (char *name = strtok_r(list, "+", &save); name;
+         name = strtok_r(NULL, "+", &save))
+    {
+        int type = match_code_type(name);
+        int code = type < 0 ? -1
+                            : libevdev_event_code_from_name(
+                                  (unsigned int)type, name);
+        if (code < 0 || r->ncaps == MATCH_MAX_CAPS)
+            return -1;
+        r->caps[r->ncaps].type = (unsigned short)type;
+        r->caps[r->ncaps].code = (unsigned short)code;
+        r->ncaps++;
+    }
+    return 0;
+}
+
+static void match_free(struct match_rule *r)
+{
+    if (r->has_name)
+        regfree(&r->name);
+    free(r->phys);
+    free(r->text);
+    memset(r, 0, sizeof(*r));
+}
+
+static void match_free_all(struct match_rule *rules, int n)
+{
+    for (int i = 0; i < n; i++)
+        match_free(&rules[i]);
+    free(rules);
+}
+
+/* Do two rule lists, as given, say the same thing? */
+static int match_same(const struct match_rule *a, int na,
+                      const struct match_rule *b, int nb)
+{
+    if (na != nb)
+        return 0;
+    for (int i = 0; i < na; i++)
+        if (strcmp(a[i].text, b[i].text) != 0)
+            return 0;
+    return 1;
+}
+
+/* Parse text into r.  Returns 0, or -1 after printing what is wrong. */
+static int match_parse(struct match_rule *r, const char *text)
+{
+    memset(r, 0, sizeof(*r));
+    r->vendor = r->product = r->bustype = -1;
+    r->text = strdup(text);
+
+    char *copy = strdup(text);
+    char *save = NULL;
+    const char *bad = NULL;
+
+    for (char *tok = strtok_r(copy, ",", &save); tok && !bad;
+         tok = strtok_r(NULL, ",", &save))
+    {
+        char *val = strchr(tok, '=');
+        if (strcmp(tok, "ignore") == 0)
         {
-            if (!libevdev_has_event_code(source_dev, type, (unsigned int)code))
-                continue;
+            r->ignore = 1;
+            continue;
+        }
+        if (!val)
+        {
+            bad = tok;
+            break;
+        }
+        *val++ = '\0';
+
+        if (strcmp(tok, "name") == 0 && !r->has_name)
+        {
+            if (regcomp(&r->name, val, REG_EXTENDED | REG_ICASE | REG_NOSUB))
+                bad = "name";
+            else
+                r->has_name = 1;
+        }
+        else if (strcmp(tok, "vendor") == 0)
+        {
+            if ((r->vendor = match_parse_hex(val)) < 0)
+                bad = tok;
+        }
+        else if (strcmp(tok, "product") == 0)
+        {
+            if ((r->product = match_parse_hex(val)) < 0)
+                bad = tok;
+        }
+        else if (strcmp(tok, "bus") == 0)
+        {
+            if ((r->bustype = match_parse_bus(val)) < 0)
+                bad = tok;
+        }
+        else if (strcmp(tok, "phys") == 0 && !r->phys)
+            r->phys = strdup(val);
+        else if (strcmp(tok, "caps") == 0)
+        {
+            if (match_parse_caps(r, val) < 0)
+                bad = tok;
+        }
+        else if (strcmp(tok, "priority") == 0)
+        {
+            if (match_parse_priority(val, &r->priority) < 0)
+                bad = tok;
+        }
+        else
+            bad = tok;
+    }
+    if (bad)
+    {
+        fprintf(stderr, "Invalid match rule '%s': bad '%s'\n", text, bad);
+        match_free(r);
+    }
+    free(copy);
+    return bad ? -1 : 0;
+}
+
+/*
+ * Append a rule, keeping the list ordered by descending priority (rules
+ * of equal priority keep the order they were given in).
+ */
+static int match_add(struct match_rule **rules, int *n, const char *text)
+{
+    struct match_rule r;
+    if (match_parse(&r, text) < 0)
+        return -1;
+
+    struct match_rule *grown = realloc(*rules, (size_t)(*n + 1) * sizeof(r));
+    if (!grown)
+    {
+        perror("realloc");
+        match_free(&r);
+        return -1;
+    }
+    *rules = grown;
+
+    int i = *n;
+    while (i > 0 && grown[i - 1].priority < r.priority)
+    {
+        grown[i] = grown[i - 1];
+        i--;
+    }
+    grown[i] = r;
+    (*n)++;
+    return 0;
+}
+
+/* Bitmask of the event types whose capabilities the rules test. */
+static unsigned int match_types(const struct match_rule *rules, int n)
+{
+    unsigned int types = 0;
+    for (int i = 0; i < n; i++)
+        for (int c = 0; c < rules[i].ncaps; c++)
+            types |= 1u << rules[i].caps[c].type;
+    return types;
+}
+
+/* ── Device auto-detection ────────────────────────────────────────────── */
+
+/* Suffix of our own virtual devices, which must never be picked up. */
+#define VIRTUAL_NAME_SUFFIX " (smooth scroll)"
+
+/*
+ * What sysfs says about an input node.  Discovery reads only these
+ * attributes, so no node is opened (and no driver is woken up by an
+ * ioctl) until it has been chosen.  Only the capability bitmaps some
+ * rule tests are read.
+ */
+struct input_info
+{
+    char name[256];
+    char phys[256];
+    unsigned long bits[EV_CNT][NLONGS(KEY_CNT)]; /* capabilities/<type> */
+    unsigned int bustype, vendor, product, version;
+};
+
+/* Read a one-line sysfs attribute into buf, without the newline. */
+static int sysfs_read(const char *path, char *buf, size_t len)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    ssize_t n = read(fd, buf, len - 1);
+    close(fd);
+    if (n < 0)
+        return -1;
+    buf[n] = '\0';
+    buf[strcspn(buf, "\n")] = '\0';
+    return 0;
+}
+
+/*
+ * Parse a sysfs capability bitmap: space-separated hex words, the most
+ * significant first and leading zero words left out.
+ */
+static void sysfs_parse_bitmap(const char *s, unsigned long *bits,
+                               size_t nlongs)
+{
+    size_t words = 0;
+    memset(bits, 0, nlongs * sizeof(*bits));
+
+    for (const char *p = s; *p;)
+    {
+        while (*p == ' ')
+            p++;
+        if (!*p)
+            break;
+        words++;
+        while (*p && *p != ' ')
+            p++;
+    }
+
+    char *end;
+    for (const char *p = s; words > 0; words--, p = end)
+    {
+        unsigned long w = strtoul(p, &end, 16);
+        if (words - 1 < nlongs)
+            bits[words - 1] = w;
+    }
+}
+
+static unsigned int sysfs_read_hex(const char *node, const char *attr)
+{
+    char path[320], buf[32];
+    snprintf(path, sizeof(path), "/sys/class/input/%s/device/%s", node, attr);
+    if (sysfs_read(path, buf, sizeof(buf)) < 0)
+        return 0;
+    return (unsigned int)strtoul(buf, NULL, 16);
+}
+
+/* Fill info for node ("eventN") from /sys/class/input.  Returns 0 or -1. */
+static int input_info_read(const char *node, unsigned int types,
+                           struct input_info *info)
+{
+    static const char *const cap_files[EV_CNT] = {
+        [EV_KEY] = "key", [EV_REL] = "rel", [EV_ABS] = "abs",
+        [EV_MSC] = "msc", [EV_SW] = "sw",   [EV_LED] = "led",
+        [EV_SND] = "snd",
+    };
+    char path[320], buf[1024];
+
+    memset(info, 0, sizeof(*info));
+    snprintf(path, sizeof(path), "/sys/class/input/%s/device/name", node);
+    if (sysfs_read(path, info->name, sizeof(info->name)) < 0)
+        return -1;
+
+    snprintf(path, sizeof(path), "/sys/class/input/%s/device/phys", node);
+    sysfs_read(path, info->phys, sizeof(info->phys));
+
+    for (unsigned int type = 0; type < EV_CNT; type++)
+    {
+        if (!(types & (1u << type)) || !cap_files[type])
+            continue;
+        snprintf(path, sizeof(path),
+                 "/sys/class/input/%s/device/capabilities/%s", node,
+                 cap_files[type]);
+        if (sysfs_read(path, buf, sizeof(buf)) < 0)
+            return -1;
+        sysfs_parse_bitmap(buf, info->bits[type], NLONGS(KEY_CNT));
+    }
+
+    info->bustype = sysfs_read_hex(node, "id/bustype");
+    info->vendor = sysfs_read_hex(node, "id/vendor");
+    info->product = sysfs_read_hex(node, "id/product");
+    info->version = sysfs_read_hex(node, "id/version");
+    return 0;
+}
+
+static int match_rule_test(const struct match_rule *r,
+                           const struct input_info *info)
+{
+    if (r->has_name && regexec(&r->name, info->name, 0, NULL, 0) != 0)
+        return 0;
+    if (r->vendor >= 0 && (unsigned int)r->vendor != info->vendor)
+        return 0;
+    if (r->product >= 0 && (unsigned int)r->product != info->product)
+        return 0;
+    if (r->bustype >= 0 && (unsigned int)r->bustype != info->bustype)
+        return 0;
+    if (r->phys && fnmatch(r->phys, info->phys, 0) != 0)
+        return 0;
+    for (int c = 0; c < r->ncaps; c++)
+        if (!test_bit(info->bits[r->caps[c].type], r->caps[c].code))
+            return 0;
+    return 1;
+}
+
+/*
+ * Check the input node ("eventN") against the match rules, from sysfs
+ * alone, and fill in info.  Returns the rule that selects it for
+ * smoothing, or NULL if no rule does, an ignore rule matched first, or
+ * it is one of our own virtual devices.
+ */
+static const struct match_rule *probe_scroll_device(const struct config *cfg,
+                                                    const char *node,
+                                                    struct input_info *info)
+{
+    if (input_info_read(node, cfg->match_types, info) < 0)
+        return NULL;
+    if (strstr(info->name, VIRTUAL_NAME_SUFFIX) != NULL)
+        return NULL;
+
+    for (int i = 0; i < cfg->nrules; i++)
+    {
+        if (match_rule_test(&cfg->rules[i], info))
+            return cfg->rules[i].ignore ? NULL : &cfg->rules[i];
+    }
+    return NULL;
+}
+
+/*
+ * Scan /sys/class/input/event* for every device the match rules select
+ * and store up to max of their /dev/input paths, higher-priority matches
+ * first.  The number of nodes looked at goes to *scanned.  Returns the
+ * number stored.
+ */
+static int find_scroll_devices(const struct config *cfg, char (*paths)[280],
+                               int max, int *scanned)
+{
+    *scanned = 0;
+    DIR *dir = opendir("/sys/class/input");
+    if (!dir)
+    {
+        perror("opendir /sys/class/input");
+        return 0;
+    }
+
+    struct dirent *ent;
+    struct input_info info;
+    int prio[MAX_DEVICES]; /* max <= MAX_DEVICES */
+    int n = 0;
+
+    while ((ent = readdir(dir)) != NULL)
+    {
+        if (strncmp(ent->d_name, "event", 5) != 0)
+            continue;
+
+        (*scanned)++;
+        const struct match_rule *r = probe_scroll_device(cfg, ent->d_name,
+                                                         &info);
+        if (!r)
+            continue;
 
-            unsigned long req = 0;
-            switch (type)
+        fprintf(stderr,
+                "Found scroll device: /dev/input/%s (%s, bus %04x vendor "
+                "%04x product %04x) by rule '%s'\n",
+                ent->d_name, info.name, info.bustype, info.vendor,
+                info.product, r->text);
+
+        /* Insert by priority; when full, drop the lowest one. */
+        int i = n < max ? n++ : max;
+        while (i > 0 && prio[i - 1] < r->priority)
+        {
+            if (i < max)
             {
-            case EV_KEY:
-                req = UI_SET_KEYBIT;
-                break;
-            case EV_REL:
-                req = UI_SET_RELBIT;
-                break;
-            case EV_ABS:
-                req = UI_SET_ABSBIT;
-                break;
-            case EV_MSC:
-                req = UI_SET_MSCBIT;
-                break;
-            case EV_LED:
-                req = UI_SET_LEDBIT;
-                break;
-            case EV_SND:
-                req = UI_SET_SNDBIT;
-                break;
-            case EV_FF:
-                req = UI_SET_FFBIT;
-                break;
-            case EV_SW:
-                req = UI_SET_SWBIT;
-                break;
-            default:
+                prio[i] = prio[i - 1];
+                memcpy(paths[i], paths[i - 1], sizeof(paths[i]));
+            }
+            i--;
+        }
+        if (i < max)
+        {
+            prio[i] = r->priority;
+            snprintf(paths[i], sizeof(paths[i]), "/dev/input/%.250s",
+                     ent->d_name);
+        }
+    }
+
+    closedir(dir);
+    return n;
+}
+
+/* ── Source device ────────────────────────────────────────────────────── */
+
+/* The grabbed input device; fd is -1 while waiting for it to come back. */
+struct source
+{
+    int fd;
+    struct libevdev *evdev;
+    int kernel_ts; /* ev.time is CLOCK_MONOTONIC (EVIOCSCLOCKID worked) */
+    char path[280];
+};
+
+/*
+ * Open path and attach libevdev.  Does not grab.  quiet keeps a node
+ * that does not exist (yet) out of the log.  Returns 0 or -1.
+ */
+static int source_open(struct source *src, const char *path, int quiet)
+{
+    src->fd = open(path, O_RDONLY | O_NONBLOCK);
+    if (src->fd < 0)
+    {
+        if (!quiet || errno != ENOENT)
+            fprintf(stderr, "open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    /* Initialize libevdev from the source device fd. */
+    src->evdev = NULL;
+    int rc = libevdev_new_from_fd(src->fd, &src->evdev);
+    if (rc < 0)
+    {
+        fprintf(stderr, "libevdev_new_from_fd: %s\n", strerror(-rc));
+        close(src->fd);
+        src->fd = -1;
+        return -1;
+    }
+    snprintf(src->path, sizeof(src->path), "%s", path);
+
+    fprintf(stderr, "Source device: %s (%s)\n",
+            path, libevdev_get_name(src->evdev));
+
+    /*
+     * Have the kernel stamp events with CLOCK_MONOTONIC (EVIOCSCLOCKID), so
+     * ev.time records when the host input was queued and can drive rate
+     * tracking directly, without a clock read per event.
+     */
+    src->kernel_ts = libevdev_set_clock_id(src->evdev, CLOCK_MONOTONIC) == 0;
+    if (!src->kernel_ts)
+        fprintf(stderr,
+                "EVIOCSCLOCKID failed; rate tracking uses receive time.\n");
+    return 0;
+}
+
+static void source_close(struct source *src)
+{
+    if (src->fd < 0)
+        return;
+
+    /* Ungrab source device so it becomes usable again. */
+    ioctl(src->fd, EVIOCGRAB, 0);
+    libevdev_free(src->evdev);
+    close(src->fd);
+    src->evdev = NULL;
+    src->fd = -1;
+}
+
+/* ── uinput device creation ───────────────────────────────────────────── */
+
+/*
+ * Capability snapshot of an evdev device: bits[0] is the event-type
+ * bitmap, bits[type] the code bitmap of each type (EV_KEY is the
+ * largest), plus the static part of every axis' absinfo.  The current
+ * axis value is left out, so two snapshots of the same device compare
+ * equal.
+ */
+struct dev_caps
+{
+    unsigned long bits[EV_CNT][NLONGS(KEY_CNT)];
+    struct
+    {
+        int minimum, maximum, fuzz, flat, resolution;
+    } abs[ABS_CNT];
+};
+
+/* The uinput request that enables a code of the given type, 0 if none. */
+static unsigned long uinput_code_request(unsigned int type)
+{
+    switch (type)
+    {
+    case EV_KEY:
+        return UI_SET_KEYBIT;
+    case EV_REL:
+        return UI_SET_RELBIT;
+    case EV_ABS:
+        return UI_SET_ABSBIT;
+    case EV_MSC:
+        return UI_SET_MSCBIT;
+    case EV_LED:
+        return UI_SET_LEDBIT;
+    case EV_SND:
+        return UI_SET_SNDBIT;
+    case EV_FF:
+        return UI_SET_FFBIT;
+    case EV_SW:
+        return UI_SET_SWBIT;
+    default:
+        return 0;
+    }
+}
+
+/*
+ * Create a uinput virtual device that mirrors all capabilities of the
+ * source, plus REL_WHEEL_HI_RES and REL_HWHEEL_HI_RES.  The capability
+ * bitmaps were fetched once per type with EVIOCGBIT (caps_read()); the
+ * set bits are found a word at a time with count-trailing-zeros, so only
+ * supported codes cost anything.  uinput has no bulk interface, so each
+ * of them still takes one ioctl.  Returns the uinput fd (>= 0) or -1.
+ */
+static int create_uinput_device(struct libevdev *source_dev,
+                                const struct dev_caps *caps, int verbose)
+{
+    int64_t start = now_ns();
+    unsigned int ioctls = 0;
+
+    int uifd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+    if (uifd < 0)
+    {
+        perror("open /dev/uinput");
+        return -1;
+    }
+
+    struct uinput_setup setup;
+    memset(&setup, 0, sizeof(setup));
+
+    /* Name the virtual device "<original> (smooth scroll)". */
+    const char *src_name = libevdev_get_name(source_dev);
+    snprintf(setup.name, UINPUT_MAX_NAME_SIZE, "%s (smooth scroll)",
+             src_name ? src_name : "Unknown");
+    setup.id.bustype = libevdev_get_id_bustype(source_dev);
+    setup.id.vendor = libevdev_get_id_vendor(source_dev);
+    setup.id.product = libevdev_get_id_product(source_dev);
+    setup.id.version = libevdev_get_id_version(source_dev);
+
+    /* Mirror every event type and code from the source device. */
+    for (size_t tw = 0; tw < NLONGS(EV_CNT); tw++)
+    {
+        for (unsigned long tbits = caps->bits[0][tw]; tbits;
+             tbits &= tbits - 1)
+        {
+            unsigned int type =
+                (unsigned int)(tw * LONG_BITS) + __builtin_ctzl(tbits);
+
+            ioctls++;
+            if (ioctl(uifd, UI_SET_EVBIT, type) < 0)
+            {
+                fprintf(stderr, "UI_SET_EVBIT %u: %s\n", type,
+                        strerror(errno));
+                /* non-fatal: some types may not be supported by uinput */
                 continue;
             }
 
-            if (ioctl(uifd, req, code) < 0)
+            unsigned long req = uinput_code_request(type);
+            if (!req)
+                continue;
+
+            for (size_t w = 0; w < NLONGS(KEY_CNT); w++)
             {
-                /* Silently skip unsupported codes. */
+                for (unsigned long bits = caps->bits[type][w]; bits;
+                     bits &= bits - 1)
+                {
+                    int code = (int)(w * LONG_BITS) + __builtin_ctzl(bits);
+                    ioctls++;
+                    if (ioctl(uifd, req, code) < 0)
+                    {
+                        /* Silently skip unsupported codes. */
+                    }
+                }
             }
         }
     }
@@ -347,34 +1401,35 @@ static int create_uinput_device(struct libevdev *source_dev)
      * Ensure hi-res scroll axes are present even if the source lacks them.
      * These are critical for smooth output.
      */
-    if (!libevdev_has_event_type(source_dev, EV_REL))
+    if (!test_bit(caps->bits[0], EV_REL))
         ioctl(uifd, UI_SET_EVBIT, EV_REL);
 
     ioctl(uifd, UI_SET_RELBIT, REL_WHEEL_HI_RES);
     ioctl(uifd, UI_SET_RELBIT, REL_HWHEEL_HI_RES);
+    ioctls += 3;
 
     /* Configure EV_ABS axes with proper absinfo (range, fuzz, etc.). */
-    if (libevdev_has_event_type(source_dev, EV_ABS))
+    for (size_t w = 0; w < NLONGS(ABS_CNT); w++)
     {
-        int abs_max = libevdev_event_type_get_max(EV_ABS);
-        for (int code = 0; code <= abs_max; code++)
+        for (unsigned long bits = caps->bits[EV_ABS][w]; bits;
+             bits &= bits - 1)
         {
-            if (!libevdev_has_event_code(source_dev, EV_ABS, (unsigned int)code))
-                continue;
-
-            const struct input_absinfo *ai =
-                libevdev_get_abs_info(source_dev, (unsigned int)code);
-            if (!ai)
-                continue;
+            unsigned int code =
+                (unsigned int)(w * LONG_BITS) + __builtin_ctzl(bits);
 
             struct uinput_abs_setup abs_setup;
             memset(&abs_setup, 0, sizeof(abs_setup));
             abs_setup.code = (unsigned short)code;
-            abs_setup.absinfo = *ai;
+            abs_setup.absinfo.minimum = caps->abs[code].minimum;
+            abs_setup.absinfo.maximum = caps->abs[code].maximum;
+            abs_setup.absinfo.fuzz = caps->abs[code].fuzz;
+            abs_setup.absinfo.flat = caps->abs[code].flat;
+            abs_setup.absinfo.resolution = caps->abs[code].resolution;
 
+            ioctls++;
             if (ioctl(uifd, UI_ABS_SETUP, &abs_setup) < 0)
             {
-                fprintf(stderr, "UI_ABS_SETUP %d: %s\n", code,
+                fprintf(stderr, "UI_ABS_SETUP %u: %s\n", code,
                         strerror(errno));
             }
         }
@@ -396,113 +1451,3275 @@ static int create_uinput_device(struct libevdev *source_dev)
     }
 
     fprintf(stderr, "Created virtual device: %s\n", setup.name);
+    if (verbose)
+        fprintf(stderr, "[uinput] %u setup ioctls, created in %.1f us\n",
+                ioctls + 2, (double)(now_ns() - start) / 1e3);
     return uifd;
 }
 
-/* ── Event helpers ────────────────────────────────────────────────────── */
+/* ── Output frame buffer ──────────────────────────────────────────────── */
+
+/*
+ * Events bound for uinput are collected per frame and written with a
+ * single write(2) of the whole array when the frame's SYN_REPORT is
+ * queued, instead of one syscall per event.  A frame that outgrows the
+ * buffer is flushed early; the kernel only delivers it at the SYN anyway.
+ */
+#define OUT_FRAME_MAX 64
 
-static int write_event(int uifd, unsigned short type, unsigned short code,
-                       int value)
+struct out_frame
 {
-    struct input_event ev;
-    memset(&ev, 0, sizeof(ev));
-    ev.type = type;
-    ev.code = code;
-    ev.value = value;
+    int fd;                              /* uinput fd                */
+    int n;                               /* events queued            */
+    struct input_event ev[OUT_FRAME_MAX];
+    uint64_t frames;                     /* SYN_REPORTs flushed      */
+    uint64_t syscalls;                   /* write(2) calls issued    */
+    unsigned long keys[NLONGS(KEY_CNT)]; /* key state written so far */
+};
+
+static int out_flush(struct out_frame *of)
+{
+    if (of->n == 0)
+        return 0;
+
+    size_t len = (size_t)of->n * sizeof(struct input_event);
+    int queued = of->n;
+    of->n = 0;
+    of->syscalls++;
+
+    ssize_t n = write(of->fd, of->ev, len);
+    if (n < 0)
+    {
+        perror("write uinput events");
+        return -1;
+    }
+
+    /* Shadow the key state the virtual device now has, for resyncs. */
+    for (int i = 0; i < queued; i++)
+    {
+        const struct input_event *ev = &of->ev[i];
+        if (ev->type != EV_KEY || ev->code >= KEY_CNT)
+            continue;
+        unsigned long mask = 1UL << (ev->code % LONG_BITS);
+        if (ev->value)
+            of->keys[ev->code / LONG_BITS] |= mask;
+        else
+            of->keys[ev->code / LONG_BITS] &= ~mask;
+    }
+    return 0;
+}
+
+static int write_event(struct out_frame *of, unsigned short type,
+                       unsigned short code, int value)
+{
+    if (of->n == OUT_FRAME_MAX && out_flush(of) < 0)
+        return -1;
+
+    struct input_event *ev = &of->ev[of->n++];
+    memset(ev, 0, sizeof(*ev));
+    ev->type = type;
+    ev->code = code;
+    ev->value = value;
+    return 0;
+}
+
+/* Queue SYN_REPORT and write out the whole frame. */
+static int write_syn(struct out_frame *of)
+{
+    if (write_event(of, EV_SYN, SYN_REPORT, 0) < 0)
+        return -1;
+    of->frames++;
+    return out_flush(of);
+}
+
+static void out_summary(uint64_t frames, uint64_t syscalls)
+{
+    if (frames)
+        fprintf(stderr, "Output: %llu frames, %.2f write syscalls/frame\n",
+                (unsigned long long)frames,
+                (double)syscalls / (double)frames);
+}
+
+static int is_scroll_code(unsigned short code)
+{
+    return code == REL_WHEEL || code == REL_HWHEEL ||
+           code == REL_WHEEL_HI_RES || code == REL_HWHEEL_HI_RES;
+}
+
+/*
+ * Friction model: exponential decay of the remaining distance, applied
+ * analytically as (1 - friction)^(dt / 4 ms), so a late or merged timer
+ * tick catches up in one step instead of losing momentum, and the glide
+ * length does not depend on host load.  Returns the distance covered.
+ */
+static double step_friction(struct axis_state *as,
+                            const struct axis_params *ap, int64_t dt)
+{
+    double old_vel = as->velocity;
+    as->velocity *= exp(ap->decay_per_ns * (double)dt);
+    return old_vel - as->velocity;
+}
+
+/*
+ * Only one of the two velocity representations is in use, the other is
+ * 0, so these hold for either without converting.
+ */
+static int axis_moving(const struct axis_state *as)
+{
+    return as->velocity != 0.0 || as->velocity_q != 0;
+}
+
+static int axis_sign(const struct axis_state *as)
+{
+    if (as->velocity_q)
+        return as->velocity_q > 0 ? 1 : -1;
+    return (as->velocity > 0.0) - (as->velocity < 0.0);
+}
+
+/* Velocity and remainder as doubles, for the --verbose trace. */
+static double axis_velocity(const struct axis_state *as)
+{
+    return as->velocity + (double)as->velocity_q / (double)Q32_ONE;
+}
+
+static double axis_accum(const struct axis_state *as)
+{
+    return as->emit_accum + (double)as->accum_q / (double)Q32_ONE;
+}
+
+/* Take over a glide in progress when an axis switches to --fixed-point. */
+static void fx_load(struct axis_state *as)
+{
+    as->velocity_q += (int64_t)(as->velocity * (double)Q32_ONE);
+    as->accum_q += (int64_t)(as->emit_accum * (double)Q32_ONE);
+    as->velocity = 0.0;
+    as->emit_accum = 0.0;
+}
+
+/* And hand it back when the axis leaves --fixed-point. */
+static void fx_unload(struct axis_state *as)
+{
+    as->velocity = axis_velocity(as);
+    as->emit_accum = axis_accum(as);
+    as->velocity_q = 0;
+    as->accum_q = 0;
+}
+
+/*
+ * step_friction() plus the sub-pixel accumulation in integers, for
+ * --fixed-point.  Returns the whole hi-res units to emit.
+ */
+static int step_fixed(struct axis_state *as, const struct axis_params *ap,
+                      int64_t dt)
+{
+    int64_t old = as->velocity_q;
+    as->velocity_q = fx_mul(old, fx_decay(ap->decay_q, dt), 32);
+    as->accum_q += old - as->velocity_q;
+
+    int64_t units = as->accum_q / Q32_ONE;
+    as->accum_q -= units * Q32_ONE;
+    return (int)units;
+}
+
+/*
+ * Spring model: the remaining distance e follows a critically damped
+ * spring towards zero, e'' + 2we' + w^2 e = 0, stepped in closed form:
+ *
+ *   e(t) = (e0 + (u0 + w e0) t) exp(-w t)
+ *
+ * Input moves the target (adds to e) but not the speed u, so the motion
+ * stays continuous and starts from rest with zero speed.  spring_ms after
+ * the last input whatever is left is covered at once, so every notch
+ * settles within a bounded time.  Returns the distance covered.
+ */
+static double step_spring(struct axis_state *as, const struct axis_params *ap,
+                          int64_t dt, int64_t now)
+{
+    double e = as->velocity;
+    double w = ap->spring_omega_per_ns;
+
+    if (now - as->last_input_ns >= ap->spring_ms * 1000000LL)
+    {
+        as->velocity = 0.0;
+        as->spring_speed = 0.0;
+        return e;
+    }
+
+    double t = (double)dt;
+    double b = as->spring_speed + w * e;
+    double decay = exp(-w * t);
+    as->velocity = (e + b * t) * decay;
+    as->spring_speed = (b - w * (e + b * t)) * decay;
+    return e - as->velocity;
+}
+
+/* Below the stop threshold, and (spring) not just passing the target. */
+static int axis_at_rest(const struct axis_state *as,
+                        const struct axis_params *ap)
+{
+    if (ap->fixed)
+        return llabs(as->velocity_q) < ap->stop_q;
+    if (fabs(as->velocity) >= ap->stop_threshold)
+        return 0;
+    return ap->model != MODEL_SPRING ||
+           fabs(as->spring_speed) * (double)FRICTION_REF_NS <
+               ap->stop_threshold;
+}
+
+/*
+ * Perform one emission step for a single axis: advance the physics model
+ * over the time elapsed since the previous step, accumulate into
+ * sub-pixel remainder, and emit the integer part as a hi-res scroll
+ * event.
+ *
+ * Also emits the corresponding low-res event (REL_WHEEL / REL_HWHEEL)
+ * every time the hi-res accumulator crosses a 120-unit boundary.  This
+ * is the standard Linux kernel convention: devices that send
+ * REL_WHEEL_HI_RES must also send REL_WHEEL for compatibility with
+ * applications that only handle the low-res variant.
+ *
+ * Events are queued in the output frame; the caller's write_syn() flushes.
+ * label names the axis in the --verbose trace, NULL when not tracing.
+ * Returns 1 if any event was queued, 0 otherwise.
+ */
+static int emit_axis(struct out_frame *out, struct axis_state *as,
+                     unsigned short hires_code, const struct axis_params *ap,
+                     const char *label, int64_t now)
+{
+    if (axis_at_rest(as, ap))
+    {
+        as->velocity = 0.0;
+        as->spring_speed = 0.0;
+        as->emit_accum = 0.0;
+        as->velocity_q = 0;
+        as->accum_q = 0;
+        as->lowres_accum = 0;
+        as->input_ns = 0;
+        as->reversal_ns = 0;
+        return 0;
+    }
+
+    /*
+     * Input steps run at the kernel timestamp of the event, which can
+     * predate the last timer step; never move the step clock backwards.
+     */
+    int64_t dt = now - as->last_step_ns;
+    if (dt < 0)
+        dt = 0;
+    else
+        as->last_step_ns = now;
+
+    int emit_int;
+    if (ap->fixed)
+        emit_int = step_fixed(as, ap, dt);
+    else
+    {
+        double emit = ap->model == MODEL_SPRING
+                          ? step_spring(as, ap, dt, now)
+                          : step_friction(as, ap, dt);
+
+        /*
+         * Sub-pixel accumulation: accumulate the fractional hi-res
+         * units and only emit the integer part.  This prevents
+         * uneven step sizes that appear as micro-stutter.
+         */
+        as->emit_accum += emit;
+        emit_int = (int)as->emit_accum;
+        as->emit_accum -= (double)emit_int;
+    }
+
+    /* Past the target: the remaining distance changed sign. */
+    if (as->velocity * as->target_sign < 0.0 &&
+        fabs(as->velocity) > as->overshoot)
+        as->overshoot = fabs(as->velocity);
+
+    if (emit_int != 0)
+    {
+        write_event(out, EV_REL, hires_code, emit_int);
+        as->emit_dir = emit_int > 0 ? 1 : -1;
+
+        /*
+         * Low-res compatibility: accumulate hi-res units and emit
+         * REL_WHEEL/REL_HWHEEL every 120 units.  Many applications
+         * (Firefox, Electron, older X11 toolkits) only handle the
+         * low-res event codes.
+         */
+        unsigned short lowres_code =
+            (hires_code == REL_WHEEL_HI_RES) ? REL_WHEEL : REL_HWHEEL;
+        as->lowres_accum += emit_int;
+        while (as->lowres_accum >= HIRES_PER_TICK)
+        {
+            write_event(out, EV_REL, lowres_code, 1);
+            as->lowres_accum -= HIRES_PER_TICK;
+        }
+        while (as->lowres_accum <= -HIRES_PER_TICK)
+        {
+            write_event(out, EV_REL, lowres_code, -1);
+            as->lowres_accum += HIRES_PER_TICK;
+        }
+
+        if (label)
+        {
+            fprintf(stderr,
+                    "[emit] %s hires=%d vel=%.1f accum=%.3f "
+                    "lowres_accum=%d\n",
+                    label, emit_int, axis_velocity(as), axis_accum(as),
+                    as->lowres_accum);
+        }
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Force-emit ±1 hi-res unit for an axis whose regular step produced
+ * nothing, so every scroll input — no matter how small — produces
+ * immediate visible feedback.  Critical for very slow, precise trackpad
+ * scrolling where the host sends tiny scroll deltas.
+ *
+ * Returns 1 if an event was queued, 0 if the axis is below the stop
+ * threshold.
+ */
+static int emit_min_step(struct out_frame *out, struct axis_state *as,
+                         unsigned short hires_code,
+                         const struct axis_params *ap, const char *label)
+{
+    if (ap->fixed ? llabs(as->velocity_q) < ap->stop_q
+                  : fabs(as->velocity) < ap->stop_threshold)
+        return 0;
+
+    int dir = axis_sign(as);
+    write_event(out, EV_REL, hires_code, dir);
+    as->emit_dir = dir;
+    as->lowres_accum += dir;
+    if (ap->fixed)
+    {
+        as->velocity_q -= dir * Q32_ONE;
+        as->accum_q = 0;
+    }
+    else
+    {
+        as->velocity -= (double)dir;
+        as->emit_accum = 0.0;
+    }
+
+    if (label)
+        fprintf(stderr, "[emit] %s hires=%d (min) vel=%.1f\n",
+                label, dir, axis_velocity(as));
+    return 1;
+}
+
+/* ── Virtual device mirror ────────────────────────────────────────────── */
+
+static int caps_read(int fd, struct dev_caps *c)
+{
+    memset(c, 0, sizeof(*c));
+    if (ioctl(fd, EVIOCGBIT(0, sizeof(c->bits[0])), c->bits[0]) < 0)
+        return -1;
+
+    for (unsigned int type = 1; type < EV_CNT; type++)
+    {
+        if (!test_bit(c->bits[0], type))
+            continue;
+        if (ioctl(fd, EVIOCGBIT(type, sizeof(c->bits[type])),
+                  c->bits[type]) < 0)
+            return -1;
+    }
+
+    for (unsigned int code = 0; code < ABS_CNT; code++)
+    {
+        if (!test_bit(c->bits[EV_ABS], code))
+            continue;
+        struct input_absinfo ai;
+        if (ioctl(fd, EVIOCGABS(code), &ai) < 0)
+            return -1;
+        c->abs[code].minimum = ai.minimum;
+        c->abs[code].maximum = ai.maximum;
+        c->abs[code].fuzz = ai.fuzz;
+        c->abs[code].flat = ai.flat;
+        c->abs[code].resolution = ai.resolution;
+    }
+    return 0;
+}
+
+/* Number of type/code bits and axis ranges that differ. */
+static int caps_diff(const struct dev_caps *a, const struct dev_caps *b)
+{
+    int n = 0;
+    for (unsigned int t = 0; t < EV_CNT; t++)
+        for (size_t i = 0; i < NLONGS(KEY_CNT); i++)
+            n += __builtin_popcountl(a->bits[t][i] ^ b->bits[t][i]);
+    for (unsigned int code = 0; code < ABS_CNT; code++)
+        n += memcmp(&a->abs[code], &b->abs[code], sizeof(a->abs[code])) != 0;
+    return n;
+}
+
+/*
+ * The uinput device mirroring a source, with the output frame buffer
+ * that writes to it (out.fd is the uinput fd) and the capabilities it
+ * was built from.  A new device is pending until udev has processed it.
+ */
+struct mirror
+{
+    struct out_frame out;
+    struct dev_caps caps;
+    char node[32];      /* eventN of the virtual device, "" if unknown */
+    int pending;        /* created, udev not known to be done with it  */
+    char db[64];        /* udev database entry to wait for, "" = none  */
+    int64_t created_ns; /* when the virtual device was created         */
+};
+
+/*
+ * Find the event node of the uinput device behind m->out.fd via
+ * UI_GET_SYSNAME, and its "major:minor" device number.
+ */
+static int mirror_resolve_node(struct mirror *m, char *devnum, size_t len)
+{
+    char sysname[64], dir[128], path[320];
+
+    if (ioctl(m->out.fd, UI_GET_SYSNAME(sizeof(sysname)), sysname) < 0)
+    {
+        perror("UI_GET_SYSNAME");
+        return -1;
+    }
+
+    snprintf(dir, sizeof(dir), "/sys/devices/virtual/input/%s", sysname);
+    DIR *d = opendir(dir);
+    if (!d)
+    {
+        fprintf(stderr, "opendir %s: %s\n", dir, strerror(errno));
+        return -1;
+    }
+
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL)
+    {
+        if (strncmp(ent->d_name, "event", 5) == 0)
+        {
+            snprintf(m->node, sizeof(m->node), "%.31s", ent->d_name);
+            break;
+        }
+    }
+    closedir(d);
+    if (!m->node[0])
+        return -1;
+
+    snprintf(path, sizeof(path), "%s/%s/dev", dir, m->node);
+    return sysfs_read(path, devnum, len);
+}
+
+/* The pending virtual device is done waiting, ready or not. */
+static void mirror_ready_report(struct mirror *m, int ready)
+{
+    double ms = (double)(now_ns() - m->created_ns) / 1e6;
+
+    m->pending = 0;
+    if (!ready)
+        fprintf(stderr,
+                "Virtual device %s not processed by udev after %.1f ms; "
+                "grabbing anyway.\n",
+                m->node, ms);
+    else
+        fprintf(stderr, "Virtual device %s ready in %.1f ms.\n",
+                m->node[0] ? m->node : "(unknown node)", ms);
+}
+
+/*
+ * Work out what tells us udev has processed the new virtual device, so
+ * libinput has picked it up before the source is grabbed and goes
+ * silent: udev is done once the node's database entry
+ * /run/udev/data/cMAJOR:MINOR exists (it is written before the event
+ * reaches libudev listeners).  Without udev there is nothing to wait for
+ * and the device is ready at once; if the node cannot be found, db stays
+ * empty and only a fixed settle delay is left.
+ */
+static void mirror_ready_prepare(struct mirror *m)
+{
+    char devnum[32];
+
+    m->pending = 1;
+    m->db[0] = '\0';
+    if (mirror_resolve_node(m, devnum, sizeof(devnum)) < 0)
+        return;
+
+    if (access("/run/udev/data", F_OK) < 0)
+        mirror_ready_report(m, 1);
+    else
+        snprintf(m->db, sizeof(m->db), "/run/udev/data/c%s", devnum);
+}
+
+/* Has udev processed the pending virtual device by now? */
+static int mirror_ready(const struct mirror *m)
+{
+    return m->db[0] && access(m->db, F_OK) == 0;
+}
+
+/*
+ * Block until the pending virtual device is ready, for startup, before
+ * the event loop runs.  Returns -1 if udev did not process it within
+ * UDEV_READY_TIMEOUT_MS.
+ */
+static int mirror_wait_ready(struct mirror *m)
+{
+    if (!m->db[0])
+    {
+        /* Old kernel or no sysfs: fall back to a fixed settle delay. */
+        usleep(UDEV_SETTLE_MS * 1000);
+        return 0;
+    }
+
+    int ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (ifd < 0)
+    {
+        perror("inotify_init1");
+        return -1;
+    }
+
+    /* udev writes a temporary file and renames it into place. */
+    inotify_add_watch(ifd, "/run/udev/data", IN_CREATE | IN_MOVED_TO);
+
+    int64_t deadline = m->created_ns + UDEV_READY_TIMEOUT_MS * 1000000LL;
+    int rc = -1;
+    while (1)
+    {
+        /* Checked after adding the watch, so no creation is missed. */
+        if (mirror_ready(m))
+        {
+            rc = 0;
+            break;
+        }
+
+        int64_t left = deadline - now_ns();
+        if (left <= 0)
+            break;
+
+        struct pollfd pfd = {.fd = ifd, .events = POLLIN};
+        if (poll(&pfd, 1, (int)((left + 999999) / 1000000)) < 0 &&
+            errno != EINTR)
+            break;
+
+        char buf[4096];
+        while (read(ifd, buf, sizeof(buf)) > 0)
+            ;
+    }
+    close(ifd);
+    return rc;
+}
+
+/*
+ * Create the virtual device for src.  The caller must let it become
+ * ready (see mirror_ready_prepare) before grabbing the source.
+ */
+static int mirror_create(struct mirror *m, const struct source *src,
+                         int verbose)
+{
+    int64_t start = now_ns();
+
+    if (caps_read(src->fd, &m->caps) < 0)
+    {
+        perror("EVIOCGBIT");
+        return -1;
+    }
+
+    memset(&m->out, 0, sizeof(m->out));
+    m->node[0] = '\0';
+    m->out.fd = create_uinput_device(src->evdev, &m->caps, verbose);
+    if (m->out.fd < 0)
+        return -1;
+
+    m->created_ns = start;
+    mirror_ready_prepare(m);
+    return 0;
+}
+
+static void mirror_destroy(struct mirror *m)
+{
+    if (m->out.fd < 0)
+        return;
+    ioctl(m->out.fd, UI_DEV_DESTROY);
+    close(m->out.fd);
+    m->out.fd = -1;
+}
+
+/*
+ * A replacement source was opened: keep the existing virtual device when
+ * its capabilities match, so udev, libinput and the compositor see no
+ * change at all, and rebuild it only when the sets really differ.
+ * Returns -1 if the device could not be rebuilt; the caller then drops
+ * the device.
+ */
+static int mirror_reconcile(struct mirror *m, const struct source *src,
+                            int verbose)
+{
+    struct dev_caps caps;
+    if (caps_read(src->fd, &caps) < 0)
+    {
+        perror("EVIOCGBIT");
+        return -1;
+    }
+
+    int diff = caps_diff(&m->caps, &caps);
+    if (diff == 0)
+    {
+        fprintf(stderr, "Capabilities match; keeping virtual device.\n");
+        return 0;
+    }
+
+    fprintf(stderr,
+            "Capabilities changed (%d differences); rebuilding virtual "
+            "device.\n",
+            diff);
+    uint64_t frames = m->out.frames;
+    uint64_t syscalls = m->out.syscalls;
+    mirror_destroy(m);
+    if (mirror_create(m, src, verbose) < 0)
+        return -1;
+    m->out.frames = frames;
+    m->out.syscalls = syscalls;
+    return 0;
+}
+
+/*
+ * Press or release every key of the virtual device whose state there
+ * differs from the source's, or release every pressed one when there is
+ * no source (evdev NULL).  Returns the number of keys changed.
+ */
+static int mirror_sync_keys(struct mirror *m, struct libevdev *evdev)
+{
+    struct out_frame *out = &m->out;
+    int changed = 0;
+
+    for (size_t w = 0; w < NLONGS(KEY_CNT); w++)
+    {
+        for (unsigned long bits = m->caps.bits[EV_KEY][w]; bits;
+             bits &= bits - 1)
+        {
+            unsigned int code =
+                (unsigned int)(w * LONG_BITS) + __builtin_ctzl(bits);
+            int down =
+                evdev && libevdev_get_event_value(evdev, EV_KEY, code) != 0;
+            if (down != test_bit(out->keys, code))
+            {
+                write_event(out, EV_KEY, (unsigned short)code, down);
+                changed++;
+            }
+        }
+    }
+    return changed;
+}
+
+/* ── Hotplug supervisor ───────────────────────────────────────────────── */
+
+/*
+ * Watch /dev/input with inotify so a source device that disappears
+ * (SPICE agent reconnect, USB redirection change) is re-acquired in place
+ * as soon as its replacement node shows up, keeping the uinput device and
+ * the axis state alive, and so newly plugged scroll devices get smoothed
+ * too.  The by-id / by-path directories are watched as well, because an
+ * explicit DEVICE_PATH is often one of their symlinks, and so is the udev
+ * database, where a new virtual device shows up once it is ready.
+ */
+struct hotplug
+{
+    int fd;         /* inotify fd, -1 if unavailable          */
+    int dev_wd;     /* watch descriptor of /dev/input         */
+    int by_id_wd;   /* watch descriptor of /dev/input/by-id   */
+    int by_path_wd; /* watch descriptor of /dev/input/by-path */
+    int udev_wd;    /* watch descriptor of /run/udev/data     */
+};
+
+/*
+ * Watch the by-id / by-path link directories not watched yet.  Best-effort:
+ * they only exist once udev has created links, and udev removes them with
+ * the last link.  Returns 1 if a watch was added.
+ */
+static int hotplug_watch_links(struct hotplug *hp)
+{
+    /* udev makes a temporary link and renames it into place. */
+    uint32_t mask = IN_CREATE | IN_MOVED_TO;
+    int added = 0;
+
+    if (hp->by_id_wd < 0)
+    {
+        hp->by_id_wd = inotify_add_watch(hp->fd, "/dev/input/by-id", mask);
+        added |= hp->by_id_wd >= 0;
+    }
+    if (hp->by_path_wd < 0)
+    {
+        hp->by_path_wd =
+            inotify_add_watch(hp->fd, "/dev/input/by-path", mask);
+        added |= hp->by_path_wd >= 0;
+    }
+    return added;
+}
+
+static int hotplug_init(struct hotplug *hp)
+{
+    hp->dev_wd = -1;
+    hp->by_id_wd = -1;
+    hp->by_path_wd = -1;
+    hp->udev_wd = -1;
+    hp->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (hp->fd < 0)
+    {
+        perror("inotify_init1");
+        return -1;
+    }
+
+    hp->dev_wd =
+        inotify_add_watch(hp->fd, "/dev/input", IN_CREATE | IN_ATTRIB);
+    if (hp->dev_wd < 0)
+    {
+        perror("inotify_add_watch /dev/input");
+        close(hp->fd);
+        hp->fd = -1;
+        return -1;
+    }
+
+    hotplug_watch_links(hp);
+
+    /* udev writes a temporary file and renames it into place. */
+    hp->udev_wd = inotify_add_watch(hp->fd, "/run/udev/data",
+                                    IN_CREATE | IN_MOVED_TO);
+    return 0;
+}
+
+/*
+ * Is the inotify event about want, an explicit DEVICE_PATH, or about the
+ * node it links to?
+ */
+static int hotplug_names(const struct hotplug *hp,
+                         const struct inotify_event *ie, const char *want)
+{
+    char path[280], node[PATH_MAX];
+    const char *dir = ie->wd == hp->dev_wd       ? "/dev/input"
+                      : ie->wd == hp->by_id_wd   ? "/dev/input/by-id"
+                      : ie->wd == hp->by_path_wd ? "/dev/input/by-path"
+                                                 : NULL;
+    if (!dir || !ie->len)
+        return 0;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, ie->name);
+    if (strcmp(path, want) == 0)
+        return 1;
+    return realpath(want, node) && strcmp(node, path) == 0;
+}
+
+/* ── Timer scheduling ─────────────────────────────────────────────────── */
+
+/*
+ * axis_due_ns() below for --fixed-point, without libm: the first step
+ * count of fx_decay_steps() after which step_fixed() would emit a whole
+ * unit, or leave the velocity under the stop threshold, found bit by
+ * bit.  The remaining velocity only shrinks as the step count grows.
+ */
+static int64_t axis_due_ns_q(const struct axis_state *as,
+                             const struct axis_params *ap)
+{
+    int64_t v = llabs(as->velocity_q);
+    if (v == 0)
+        return INT64_MAX;
+    if (v < ap->stop_q)
+        return 0;
+
+    /* The unit is due once no more than v - need is left. */
+    int64_t need = as->velocity_q > 0 ? Q32_ONE - as->accum_q
+                                      : Q32_ONE + as->accum_q;
+    int64_t left = v - need > ap->stop_q - 1 ? v - need : ap->stop_q - 1;
+
+    uint64_t n = 0;
+    for (int bit = FX_DECAY_BITS - 1; bit >= 0; bit--)
+    {
+        uint64_t m = n | 1ULL << bit;
+        if (fx_mul(v, fx_decay_steps(ap->decay_q, m), 32) > left)
+            n = m;
+    }
+
+    /* The first dt that fx_decay() maps to n + 1 steps. */
+    return (int64_t)(((n + 1) * (uint64_t)FRICTION_REF_NS +
+                      (1u << FX_DECAY_REF_BIT) - 1) >>
+                     FX_DECAY_REF_BIT);
+}
+
+/*
+ * Nanoseconds after the axis' last step at which its next integer hi-res
+ * unit becomes due, from the closed-form decay v(t) = v * e^(k t): the
+ * emitted amount v - v(t) must cover what emit_accum still lacks.  If the
+ * glide stops first, the stop time is returned instead so the axis gets
+ * zeroed on schedule.  INT64_MAX means the axis is at rest.
+ */
+static int64_t axis_due_ns(const struct axis_state *as,
+                           const struct axis_params *ap)
+{
+    if (ap->fixed)
+        return axis_due_ns_q(as, ap);
+
+    double v = as->velocity;
+    if (v == 0.0)
+        return INT64_MAX;
+
+    /* The spring has no closed-form due time: step it every tick. */
+    if (ap->model == MODEL_SPRING)
+        return 0;
+
+    double ratio = ap->stop_threshold / fabs(v);
+    if (ratio >= 1.0)
+        return 0;
+    double t_stop = log(ratio) / ap->decay_per_ns;
+
+    double need = (v > 0.0) ? 1.0 - as->emit_accum : -1.0 - as->emit_accum;
+    double frac = need / v;
+    if (frac >= 1.0)
+        return (int64_t)t_stop;
+
+    double t_due = log(1.0 - frac) / ap->decay_per_ns;
+    return (int64_t)(t_due < t_stop ? t_due : t_stop);
+}
+
+/*
+ * Tickless deadline: the earliest due time over both axes, but never
+ * before `earliest`, which keeps the cadence at most one wakeup per tick
+ * when the glide is fast.
+ */
+static int64_t tickless_deadline(const struct axis_state *vert,
+                                 const struct axis_state *horiz,
+                                 const struct config *cfg, int64_t earliest)
+{
+    int64_t deadline = INT64_MAX;
+    const struct axis_state *axes[AXIS_COUNT] = {vert, horiz};
+
+    for (int i = 0; i < AXIS_COUNT; i++)
+    {
+        int64_t due = axis_due_ns(axes[i], &cfg->axis[i]);
+        if (due == INT64_MAX)
+            continue;
+        due += axes[i]->last_step_ns + TICKLESS_SLACK_NS;
+        if (due < deadline)
+            deadline = due;
+    }
+    return deadline < earliest ? earliest : deadline;
+}
+
+/* Arm the timerfd for an absolute CLOCK_MONOTONIC deadline. */
+static int arm_timer(int tfd, int64_t deadline_ns)
+{
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = (time_t)(deadline_ns / 1000000000LL);
+    its.it_value.tv_nsec = (long)(deadline_ns % 1000000000LL);
+    /* No interval — we reschedule each tick as an absolute time. */
+    return timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+/* Disarm the timerfd so an idle daemon takes no timer wakeups at all. */
+static int disarm_timer(int tfd)
+{
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    return timerfd_settime(tfd, 0, &its, NULL);
+}
+
+/*
+ * Return the first point on the tick grid (grid + k * tick_ns) that lies
+ * strictly after now, so a re-armed timer keeps the original phase.
+ */
+static int64_t next_on_grid(int64_t grid_ns, int64_t tick_ns, int64_t now)
+{
+    if (grid_ns > now)
+        return grid_ns;
+    return grid_ns + ((now - grid_ns) / tick_ns + 1) * tick_ns;
+}
+
+/* ── Refresh-locked frame clock ───────────────────────────────────────── */
+
+/*
+ * Frames fall on the grid offset + k * period of CLOCK_MONOTONIC.  The
+ * timer is armed lead_ns before each frame; a PI loop filter on the
+ * observed phase error (wakeup time - frame time) adjusts lead_ns so the
+ * emission lands on the frame boundary despite timer and scheduling
+ * latency, and keeps tracking it as that latency drifts.
+ */
+struct frame_pll
+{
+    int64_t period_ns; /* display refresh period                       */
+    int64_t offset_ns; /* frame phase, in [0, period_ns)               */
+    double lead_ns;    /* how early the timer is armed (loop output)   */
+    double integ_ns;   /* integral term of the loop filter             */
+    uint64_t frames;   /* frames handled                               */
+    uint64_t missed;   /* frames skipped because a wakeup ran late     */
+};
+
+static void pll_init(struct frame_pll *pll, const struct config *cfg)
+{
+    memset(pll, 0, sizeof(*pll));
+    pll->period_ns = (int64_t)(1e9 / cfg->refresh_hz);
+    pll->offset_ns = ((int64_t)cfg->phase_offset_us * 1000LL) % pll->period_ns;
+    if (pll->offset_ns < 0)
+        pll->offset_ns += pll->period_ns;
+}
+
+/* First frame whose arm time still lies after now. */
+static int64_t pll_next_frame(const struct frame_pll *pll, int64_t now)
+{
+    return next_on_grid(pll->offset_ns, pll->period_ns,
+                        now + (int64_t)pll->lead_ns);
+}
+
+/* When to arm the timer for frame_ns. */
+static int64_t pll_arm_ns(const struct frame_pll *pll, int64_t frame_ns)
+{
+    return frame_ns - (int64_t)pll->lead_ns;
+}
+
+static double clampd(double v, double lo, double hi)
+{
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+/*
+ * Feed the wakeup observed at now for frame_ns into the loop filter and
+ * return the next frame to target.  A wakeup that overran whole frames
+ * coalesces them: the skipped frames are counted and the next target is
+ * the first one still reachable.
+ */
+static int64_t pll_update(struct frame_pll *pll, int64_t frame_ns, int64_t now)
+{
+    double max_lead = (double)pll->period_ns / 4.0;
+    double err = (double)(now - frame_ns);
+
+    /* Outliers (host stalls) are coalesced below, not fed to the loop. */
+    if (fabs(err) < (double)pll->period_ns / 2.0)
+    {
+        pll->integ_ns = clampd(pll->integ_ns + PLL_KI * err, 0.0, max_lead);
+        pll->lead_ns = clampd(pll->integ_ns + PLL_KP * err, 0.0, max_lead);
+    }
+    pll->frames++;
+
+    int64_t next = frame_ns + pll->period_ns;
+    if (next - (int64_t)pll->lead_ns <= now)
+    {
+        next = pll_next_frame(pll, now);
+        pll->missed += (uint64_t)((next - frame_ns) / pll->period_ns - 1);
+    }
+    return next;
+}
+
+static void pll_summary(const struct frame_pll *pll)
+{
+    fprintf(stderr,
+            "Refresh lock: period %.3f ms, lead %.1f us, %llu frames, "
+            "%llu missed\n",
+            (double)pll->period_ns / 1e6, pll->lead_ns / 1e3,
+            (unsigned long long)pll->frames,
+            (unsigned long long)pll->missed);
+}
+
+/* ── Wakeup accounting ────────────────────────────────────────────────── */
+
+/*
+ * Counts main-loop wakeups so idle behavior can be verified: with both
+ * axes at rest the timer is disarmed and the rate must drop to zero.
+ */
+struct wakeup_stats
+{
+    uint64_t total;          /* epoll_wait returns                       */
+    uint64_t timer;          /* timerfd ticks handled                    */
+    uint64_t gestures;       /* completed glides (armed → idle)          */
+    uint64_t gesture_timer;  /* timer ticks summed over those glides     */
+    uint64_t cur_timer;      /* timer ticks in the current glide         */
+    uint64_t window_total;   /* wakeups in the current report window     */
+    uint64_t window_timer;   /* timer ticks in the current report window */
+    int64_t window_start_ns; /* start of the current report window       */
+    int64_t start_ns;        /* daemon start, for the shutdown summary   */
+    int64_t idle_since_ns;   /* when the timer was disarmed, 0 = armed   */
+    int64_t idle_total_ns;   /* accumulated time with the timer disarmed */
+};
+
+#define WAKEUP_REPORT_NS 1000000000LL /* verbose report interval: 1 s */
+
+static void wakeup_report(struct wakeup_stats *ws, int64_t now)
+{
+    double secs = (double)(now - ws->window_start_ns) / 1e9;
+    fprintf(stderr, "[wakeups] %.1f/s (timer %.1f/s) over %.1f s, timer %s\n",
+            (double)ws->window_total / secs, (double)ws->window_timer / secs,
+            secs, ws->idle_since_ns ? "idle" : "armed");
+    ws->window_total = 0;
+    ws->window_timer = 0;
+    ws->window_start_ns = now;
+}
+
+/* Close the current glide; its tick count feeds the per-gesture average. */
+static void wakeup_gesture_end(struct wakeup_stats *ws, int verbose)
+{
+    ws->gestures++;
+    ws->gesture_timer += ws->cur_timer;
+    if (verbose)
+        fprintf(stderr, "[gesture] %llu timer wakeups\n",
+                (unsigned long long)ws->cur_timer);
+    ws->cur_timer = 0;
+}
+
+static void wakeup_summary(const struct wakeup_stats *ws, int64_t now,
+                           const char *scheduler)
+{
+    int64_t idle_ns = ws->idle_total_ns;
+    if (ws->idle_since_ns)
+        idle_ns += now - ws->idle_since_ns;
+
+    fprintf(stderr,
+            "Wakeups: %llu total, %llu timer; timer idle %.1f s of %.1f s\n",
+            (unsigned long long)ws->total, (unsigned long long)ws->timer,
+            (double)idle_ns / 1e9, (double)(now - ws->start_ns) / 1e9);
+    if (ws->gestures)
+        fprintf(stderr, "Gestures: %llu, %.1f timer wakeups each (%s)\n",
+                (unsigned long long)ws->gestures,
+                (double)ws->gesture_timer / (double)ws->gestures, scheduler);
+}
+
+/* ── Latency histograms ───────────────────────────────────────────────── */
+
+/*
+ * Fixed log2 buckets: bucket 0 holds 0 ns, bucket i holds [2^(i-1), 2^i)
+ * ns, the last one everything above.  Recording is a count-leading-zeros
+ * and an increment, cheap enough for every frame.
+ */
+#define HIST_BUCKETS 36 /* up to ~34 s */
+
+struct log2_hist
+{
+    uint64_t buckets[HIST_BUCKETS];
+    uint64_t count;
+    int64_t max_ns;
+};
+
+static void hist_record(struct log2_hist *h, int64_t ns)
+{
+    if (ns < 0)
+        ns = 0;
+    int b = ns ? 64 - __builtin_clzll((unsigned long long)ns) : 0;
+    if (b >= HIST_BUCKETS)
+        b = HIST_BUCKETS - 1;
+    h->buckets[b]++;
+    h->count++;
+    if (ns > h->max_ns)
+        h->max_ns = ns;
+}
+
+static void format_ns(char *buf, size_t len, int64_t ns)
+{
+    if (ns < 1000)
+        snprintf(buf, len, "%lldns", (long long)ns);
+    else if (ns < 1000000)
+        snprintf(buf, len, "%.1fus", (double)ns / 1e3);
+    else if (ns < 1000000000)
+        snprintf(buf, len, "%.1fms", (double)ns / 1e6);
+    else
+        snprintf(buf, len, "%.1fs", (double)ns / 1e9);
+}
+
+static void hist_print(const char *name, const struct log2_hist *h)
+{
+    char lo[32], hi[32];
+
+    format_ns(hi, sizeof(hi), h->max_ns);
+    fprintf(stderr, "%s: %llu samples, max %s\n", name,
+            (unsigned long long)h->count, hi);
+
+    for (int b = 0; b < HIST_BUCKETS; b++)
+    {
+        if (!h->buckets[b])
+            continue;
+        format_ns(lo, sizeof(lo), b ? 1LL << (b - 1) : 0);
+        if (b == HIST_BUCKETS - 1)
+            snprintf(hi, sizeof(hi), "inf");
+        else
+            format_ns(hi, sizeof(hi), 1LL << b);
+        fprintf(stderr, "  [%7s, %7s) %10llu  %5.1f%%\n", lo, hi,
+                (unsigned long long)h->buckets[b],
+                100.0 * (double)h->buckets[b] / (double)h->count);
+    }
+}
+
+/* Main-loop metrics, printed on SIGUSR1 and at shutdown. */
+struct metrics
+{
+    uint64_t in_events;        /* source events read                 */
+    uint64_t in_reads;         /* source wakeups that returned events */
+    uint64_t in_dropped;       /* SYN_DROPPED: kernel buffer overruns */
+    struct log2_hist latency;  /* input ev.time → uinput write       */
+    struct log2_hist lateness; /* timer wakeup after its armed time  */
+    struct log2_hist settle;   /* glide start → axis back at rest    */
+    struct log2_hist reversal; /* reversing input → output turns     */
+    uint64_t overshoots;       /* glides that went past their target */
+    double overshoot_max;      /* hi-res units                       */
+    double overshoot_sum;
+    uint64_t out_frames;       /* output of devices already removed  */
+    uint64_t out_syscalls;
+};
+
+/* The axis' pending input has reached uinput at now. */
+static void latency_record(struct metrics *m, struct axis_state *as,
+                           int64_t now)
+{
+    if (!as->input_ns)
+        return;
+    hist_record(&m->latency, now - as->input_ns);
+    as->input_ns = 0;
+}
+
+/* Output has caught up with a reversal once it moves the new way. */
+static void reversal_record(struct metrics *m, struct axis_state *as,
+                            int64_t now)
+{
+    if (!as->reversal_ns || as->emit_dir != as->reversal_dir)
+        return;
+    hist_record(&m->reversal, now - as->reversal_ns);
+    as->reversal_ns = 0;
+}
+
+/* Record time-to-settle and overshoot once a glide has come to rest. */
+static void settle_record(struct metrics *m, struct axis_state *as,
+                          int64_t now)
+{
+    if (!as->gesture_ns || axis_moving(as))
+        return;
+    hist_record(&m->settle, now - as->gesture_ns);
+    if (as->overshoot > 0.0)
+    {
+        m->overshoots++;
+        m->overshoot_sum += as->overshoot;
+        if (as->overshoot > m->overshoot_max)
+            m->overshoot_max = as->overshoot;
+    }
+    as->gesture_ns = 0;
+    as->overshoot = 0.0;
+}
+
+/* ── Real-time latency mode ───────────────────────────────────────────── */
+
+/* Touch the stack pages the main loop may use while memory is locked. */
+static void prefault_stack(void)
+{
+    volatile unsigned char buf[RT_STACK_PREFAULT];
+    for (size_t i = 0; i < sizeof(buf); i += 4096)
+        buf[i] = 0;
+}
+
+static const char *rt_result(int rc)
+{
+    return rc == 0 ? "ok" : strerror(errno);
+}
+
+/*
+ * How the process was scheduled before enter_realtime(), so switching
+ * realtime off restores it instead of widening an affinity or policy
+ * set by systemd or the admin.
+ */
+static struct
+{
+    int saved;
+    int policy;
+    struct sched_param param;
+    int have_cpus;
+    cpu_set_t cpus;
+    unsigned long slack_ns;
+} g_rt_orig;
+
+/*
+ * Apply the --realtime settings before entering the main loop, so the
+ * timerfd path is not delayed by other tasks, page faults, migrations or
+ * timer slack.  Each step is best-effort; what actually succeeded is
+ * reported, since the missing privileges only show up as judder later.
+ */
+static void enter_realtime(const struct config *cfg)
+{
+    if (!g_rt_orig.saved)
+    {
+        g_rt_orig.policy = sched_getscheduler(0);
+        if (g_rt_orig.policy < 0 ||
+            sched_getparam(0, &g_rt_orig.param) < 0)
+        {
+            g_rt_orig.policy = SCHED_OTHER;
+            memset(&g_rt_orig.param, 0, sizeof(g_rt_orig.param));
+        }
+        g_rt_orig.have_cpus = sched_getaffinity(0, sizeof(g_rt_orig.cpus),
+                                                &g_rt_orig.cpus) == 0;
+        int slack = prctl(PR_GET_TIMERSLACK, 0UL, 0UL, 0UL, 0UL);
+        g_rt_orig.slack_ns = slack < 0 ? 0 : (unsigned long)slack;
+        g_rt_orig.saved = 1;
+    }
+
+    struct sched_param sp;
+    memset(&sp, 0, sizeof(sp));
+    sp.sched_priority = cfg->rt_priority;
+    int rc = sched_setscheduler(0, SCHED_FIFO, &sp);
+    fprintf(stderr, "Realtime: SCHED_FIFO priority %d: %s\n",
+            cfg->rt_priority, rt_result(rc));
+
+    rc = mlockall(MCL_CURRENT | MCL_FUTURE);
+    fprintf(stderr, "Realtime: mlockall: %s\n", rt_result(rc));
+    if (rc == 0)
+        prefault_stack();
+
+    if (cfg->rt_cpu >= CPU_SETSIZE)
+        fprintf(stderr, "Realtime: pin to CPU %d: no such CPU\n", cfg->rt_cpu);
+    else if (cfg->rt_cpu >= 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cfg->rt_cpu, &set);
+        rc = sched_setaffinity(0, sizeof(set), &set);
+        fprintf(stderr, "Realtime: pin to CPU %d: %s\n",
+                cfg->rt_cpu, rt_result(rc));
+    }
+
+    rc = prctl(PR_SET_TIMERSLACK, 1UL, 0UL, 0UL, 0UL);
+    fprintf(stderr, "Realtime: timer slack 1 ns: %s\n", rt_result(rc));
+}
+
+/*
+ * Undo enter_realtime() when realtime is switched off at runtime: back
+ * to the policy, CPUs and timer slack the process had before.
+ */
+static void leave_realtime(void)
+{
+    if (!g_rt_orig.saved)
+        return;
+    g_rt_orig.saved = 0;
+
+    int rc = sched_setscheduler(0, g_rt_orig.policy, &g_rt_orig.param);
+    fprintf(stderr, "Realtime: restore scheduling policy: %s\n",
+            rt_result(rc));
+
+    rc = munlockall();
+    fprintf(stderr, "Realtime: munlockall: %s\n", rt_result(rc));
+
+    if (g_rt_orig.have_cpus)
+    {
+        rc = sched_setaffinity(0, sizeof(g_rt_orig.cpus), &g_rt_orig.cpus);
+        fprintf(stderr, "Realtime: restore CPU affinity: %s\n",
+                rt_result(rc));
+    }
+
+    /* A slack of 0 means the thread's default. */
+    rc = prctl(PR_SET_TIMERSLACK, g_rt_orig.slack_ns, 0UL, 0UL, 0UL);
+    fprintf(stderr, "Realtime: restore timer slack: %s\n", rt_result(rc));
+}
+
+/* ── Runtime parameters ───────────────────────────────────────────────── */
+
+/*
+ * Every struct config setting under its command-line option name, so it
+ * can be read and changed on a running daemon.  Values outside [min, max]
+ * are rejected rather than clamped, so a typo is reported instead of
+ * silently applied.
+ */
+enum param_type
+{
+    PARAM_DOUBLE,
+    PARAM_INT,
+    PARAM_BOOL,
+    PARAM_SCHEDULER,
+    PARAM_MODEL,
+    PARAM_REVERSAL,
+    PARAM_CURVE,   /* a curve_compile() spec                    */
+    PARAM_MATCH,   /* the rule list, rules separated by ';'     */
+    PARAM_DEVICES, /* DEVICE_PATH arguments, fixed at startup   */
+    PARAM_PATH,    /* a path option, fixed at startup           */
+};
+
+struct param
+{
+    const char *name;
+    enum param_type type;
+    size_t offset; /* of the field in struct config */
+    double min, max;
+};
+
+#define CFG(field) offsetof(struct config, field)
+#define AXIS(a, field)                                                      \
+    (CFG(axis) + (a) * sizeof(struct axis_params) +                         \
+     offsetof(struct axis_params, field))
+#define HORIZ(name, type, field, min, max)                                  \
+    {"h-" name, type, AXIS(AXIS_HORIZ, field), min, max}
+
+static const struct param params[] = {
+    {"model", PARAM_MODEL, AXIS(AXIS_VERT, model), 0, 0},
+    {"friction", PARAM_DOUBLE, AXIS(AXIS_VERT, friction), 0.01, 0.2},
+    {"spring-stiffness", PARAM_DOUBLE, AXIS(AXIS_VERT, spring_stiffness), 1,
+     1e6},
+    {"spring-ms", PARAM_INT, AXIS(AXIS_VERT, spring_ms), 10, 5000},
+    {"reversal", PARAM_REVERSAL, AXIS(AXIS_VERT, reversal), 0, 0},
+    {"reversal-damp", PARAM_DOUBLE, AXIS(AXIS_VERT, reversal_damp), 0, 1},
+    {"tick-ms", PARAM_INT, CFG(tick_ms), 1, 50},
+    {"scheduler", PARAM_SCHEDULER, CFG(scheduler), 0, 0},
+    {"refresh-hz", PARAM_DOUBLE, CFG(refresh_hz), 0, 1000},
+    {"phase-offset-us", PARAM_INT, CFG(phase_offset_us), -1e9, 1e9},
+    {"low-rate", PARAM_DOUBLE, AXIS(AXIS_VERT, low_rate), 0, 1e6},
+    {"high-rate", PARAM_DOUBLE, AXIS(AXIS_VERT, high_rate), 0, 1e6},
+    {"min-scale", PARAM_DOUBLE, AXIS(AXIS_VERT, min_scale), 0, 1},
+    {"curve", PARAM_CURVE, AXIS(AXIS_VERT, curve), 0, 0},
+    {"stop-threshold", PARAM_DOUBLE, AXIS(AXIS_VERT, stop_threshold), 0, 1e6},
+    {"multiplier", PARAM_DOUBLE, AXIS(AXIS_VERT, multiplier), 0.01, 10},
+    {"rate-window-ms", PARAM_INT, CFG(rate_window_ms), 10, 5000},
+    {"rate-ring-size", PARAM_INT, CFG(rate_ring_size), 2, 4096},
+    {"fixed-point", PARAM_BOOL, CFG(fixed_point), 0, 1},
+    {"realtime", PARAM_BOOL, CFG(realtime), 0, 1},
+    {"rt-priority", PARAM_INT, CFG(rt_priority), 1, 99},
+    {"cpu", PARAM_INT, CFG(rt_cpu), -1, CPU_SETSIZE - 1},
+    {"match", PARAM_MATCH, CFG(rules), 0, 0},
+    {"control-socket", PARAM_PATH, CFG(control_path), 0, 0},
+    {"device", PARAM_DEVICES, CFG(device_paths), 0, 0},
+    {"verbose", PARAM_BOOL, CFG(verbose), 0, 1},
+
+    /* Horizontal overrides; until set, each follows its vertical value. */
+    HORIZ("model", PARAM_MODEL, model, 0, 0),
+    HORIZ("friction", PARAM_DOUBLE, friction, 0.01, 0.2),
+    HORIZ("spring-stiffness", PARAM_DOUBLE, spring_stiffness, 1, 1e6),
+    HORIZ("spring-ms", PARAM_INT, spring_ms, 10, 5000),
+    HORIZ("reversal", PARAM_REVERSAL, reversal, 0, 0),
+    HORIZ("reversal-damp", PARAM_DOUBLE, reversal_damp, 0, 1),
+    HORIZ("low-rate", PARAM_DOUBLE, low_rate, 0, 1e6),
+    HORIZ("high-rate", PARAM_DOUBLE, high_rate, 0, 1e6),
+    HORIZ("min-scale", PARAM_DOUBLE, min_scale, 0, 1),
+    HORIZ("curve", PARAM_CURVE, curve, 0, 0),
+    HORIZ("stop-threshold", PARAM_DOUBLE, stop_threshold, 0, 1e6),
+    HORIZ("multiplier", PARAM_DOUBLE, multiplier, 0.01, 10),
+};
+
+#define NPARAMS (sizeof(params) / sizeof(params[0]))
+
+/* Look a parameter up by name; '_' is accepted for '-'. */
+static const struct param *param_find(const char *name)
+{
+    for (size_t i = 0; i < NPARAMS; i++)
+    {
+        const char *a = params[i].name, *b = name;
+        while (*a && (*a == *b || (*a == '-' && *b == '_')))
+            a++, b++;
+        if (!*a && !*b)
+            return &params[i];
+    }
+    return NULL;
+}
+
+static void param_format(const struct config *cfg, const struct param *p,
+                         char *buf, size_t len)
+{
+    const char *field = (const char *)cfg + p->offset;
+    size_t n = 0;
+
+    buf[0] = '\0';
+    switch (p->type)
+    {
+    case PARAM_DOUBLE:
+        snprintf(buf, len, "%g", *(const double *)field);
+        break;
+    case PARAM_INT:
+        snprintf(buf, len, "%d", *(const int *)field);
+        break;
+    case PARAM_BOOL:
+        snprintf(buf, len, "%s", *(const int *)field ? "on" : "off");
+        break;
+    case PARAM_SCHEDULER:
+        snprintf(buf, len, "%s", scheduler_names[cfg->scheduler]);
+        break;
+    case PARAM_MODEL:
+        snprintf(buf, len, "%s",
+                 model_names[*(const enum physics_model *)field]);
+        break;
+    case PARAM_REVERSAL:
+        snprintf(buf, len, "%s",
+                 reversal_names[*(const enum reversal_policy *)field]);
+        break;
+    case PARAM_CURVE:
+        snprintf(buf, len, "%s", field);
+        break;
+    case PARAM_MATCH:
+        for (int i = 0; i < cfg->nrules && n < len; i++)
+            n += (size_t)snprintf(buf + n, len - n, "%s%s", i ? "; " : "",
+                                  cfg->rules[i].text);
+        break;
+    case PARAM_DEVICES:
+        for (int i = 0; i < cfg->ndevice_paths && n < len; i++)
+            n += (size_t)snprintf(buf + n, len - n, "%s%s", i ? " " : "",
+                                  cfg->device_paths[i]);
+        if (!cfg->ndevice_paths)
+            snprintf(buf, len, "(auto)");
+        break;
+    case PARAM_PATH:
+        snprintf(buf, len, "%s", *field ? field : "(none)");
+        break;
+    }
+}
+
+/* An h- override: a field of the horizontal axis block. */
+static int param_horiz(const struct param *p)
+{
+    size_t start = CFG(axis) + AXIS_HORIZ * sizeof(struct axis_params);
+    return p->offset >= start &&
+           p->offset < start + sizeof(struct axis_params);
+}
+
+/* Size of the field behind an axis setting. */
+static size_t param_size(const struct param *p)
+{
+    switch (p->type)
+    {
+    case PARAM_INT:
+    case PARAM_BOOL:
+        return sizeof(int);
+    case PARAM_MODEL:
+        return sizeof(enum physics_model);
+    case PARAM_REVERSAL:
+        return sizeof(enum reversal_policy);
+    case PARAM_CURVE:
+        return sizeof(((struct axis_params *)0)->curve);
+    default:
+        return sizeof(double);
+    }
+}
+
+/*
+ * Parse value into p's field of cfg.  A new rule list is built for match
+ * without freeing the old one, which the caller still owns.  An h-
+ * setting stops following its vertical value.  Returns -1 with the
+ * reason in err.
+ */
+static int param_set(struct config *cfg, const struct param *p,
+                     const char *value, char *err, size_t errlen)
+{
+    char *field = (char *)cfg + p->offset;
+    char *end;
+
+    if (param_horiz(p))
+        cfg->h_set |= 1ULL << (p - params);
+
+    switch (p->type)
+    {
+    case PARAM_DOUBLE:
+    case PARAM_INT:
+    {
+        errno = 0;
+        double v = p->type == PARAM_INT ? (double)strtol(value, &end, 10)
+                                        : strtod(value, &end);
+        if (end == value || *end || errno)
+        {
+            snprintf(err, errlen, "%s: invalid value '%s'", p->name, value);
+            return -1;
+        }
+        if (v < p->min || v > p->max)
+        {
+            snprintf(err, errlen, "%s: out of range (%g to %g)", p->name,
+                     p->min, p->max);
+            return -1;
+        }
+        if (p->type == PARAM_INT)
+            *(int *)field = (int)v;
+        else
+            *(double *)field = v;
+        return 0;
+    }
+    case PARAM_BOOL:
+        if (!strcasecmp(value, "on") || !strcasecmp(value, "1") ||
+            !strcasecmp(value, "yes") || !strcasecmp(value, "true"))
+            *(int *)field = 1;
+        else if (!strcasecmp(value, "off") || !strcasecmp(value, "0") ||
+                 !strcasecmp(value, "no") || !strcasecmp(value, "false"))
+            *(int *)field = 0;
+        else
+        {
+            snprintf(err, errlen, "%s: expected on or off", p->name);
+            return -1;
+        }
+        return 0;
+    case PARAM_SCHEDULER:
+        if (strcmp(value, "fixed") == 0)
+            cfg->scheduler = SCHEDULER_FIXED;
+        else if (strcmp(value, "tickless") == 0)
+            cfg->scheduler = SCHEDULER_TICKLESS;
+        else if (strcmp(value, "refresh") == 0)
+            cfg->scheduler = SCHEDULER_REFRESH;
+        else
+        {
+            snprintf(err, errlen, "%s: expected fixed, tickless or refresh",
+                     p->name);
+            return -1;
+        }
+        return 0;
+    case PARAM_MODEL:
+        if (strcmp(value, "friction") == 0)
+            *(enum physics_model *)field = MODEL_FRICTION;
+        else if (strcmp(value, "spring") == 0)
+            *(enum physics_model *)field = MODEL_SPRING;
+        else
+        {
+            snprintf(err, errlen, "%s: expected friction or spring", p->name);
+            return -1;
+        }
+        return 0;
+    case PARAM_REVERSAL:
+        if (strcmp(value, "add") == 0)
+            *(enum reversal_policy *)field = REVERSAL_ADD;
+        else if (strcmp(value, "cancel") == 0)
+            *(enum reversal_policy *)field = REVERSAL_CANCEL;
+        else if (strcmp(value, "damp") == 0)
+            *(enum reversal_policy *)field = REVERSAL_DAMP;
+        else
+        {
+            snprintf(err, errlen, "%s: expected add, cancel or damp",
+                     p->name);
+            return -1;
+        }
+        return 0;
+    case PARAM_CURVE:
+    {
+        /* Compiled here only to check it; the engine builds its own. */
+        struct curve scratch;
+        if (strlen(value) >= sizeof(cfg->axis[0].curve))
+        {
+            snprintf(err, errlen, "%s: too long", p->name);
+            return -1;
+        }
+        if (curve_compile(&scratch, value, err, errlen) < 0)
+            return -1;
+        strcpy(field, value);
+        return 0;
+    }
+    case PARAM_MATCH:
+    {
+        struct match_rule *rules = NULL;
+        int n = 0;
+        char *copy = strdup(value);
+        char *save = NULL;
+
+        for (char *r = strtok_r(copy, ";", &save); r;
+             r = strtok_r(NULL, ";", &save))
+        {
+            r += strspn(r, " \t");
+            end = r + strlen(r);
+            while (end > r && isspace((unsigned char)end[-1]))
+                *--end = '\0';
+            if (*r && match_add(&rules, &n, r) < 0)
+            {
+                snprintf(err, errlen, "%s: invalid rule '%s'", p->name, r);
+                match_free_all(rules, n);
+                free(copy);
+                return -1;
+            }
+        }
+        free(copy);
+        cfg->rules = rules;
+        cfg->nrules = n;
+        return 0;
+    }
+    case PARAM_DEVICES:
+    case PARAM_PATH:
+        break;
+    }
+    snprintf(err, errlen, "%s: can only be set at startup", p->name);
+    return -1;
+}
+
+/*
+ * Like param_set(), for a configuration being built at startup or on
+ * reload: each match adds one rule, each device adds a path, and the
+ * startup-only paths are accepted.
+ */
+static int config_set(struct config *cfg, const struct param *p,
+                      const char *value, char *err, size_t errlen)
+{
+    char *field = (char *)cfg + p->offset;
+
+    switch (p->type)
+    {
+    case PARAM_MATCH:
+        if (match_add(&cfg->rules, &cfg->nrules, value) < 0)
+        {
+            snprintf(err, errlen, "%s: invalid rule '%s'", p->name, value);
+            return -1;
+        }
+        return 0;
+    case PARAM_DEVICES:
+        if (cfg->ndevice_paths == MAX_DEVICES)
+        {
+            snprintf(err, errlen, "too many devices (max %d)", MAX_DEVICES);
+            return -1;
+        }
+        field = cfg->device_paths[cfg->ndevice_paths++];
+        /* fall through */
+    case PARAM_PATH:
+    {
+        size_t size = p->type == PARAM_PATH ? sizeof(cfg->control_path)
+                                            : sizeof(cfg->device_paths[0]);
+        if (strlen(value) >= size)
+        {
+            snprintf(err, errlen, "%s: path too long", p->name);
+            return -1;
+        }
+        strcpy(field, value);
+        return 0;
+    }
+    default:
+        return param_set(cfg, p, value, err, errlen);
+    }
+}
+
+/*
+ * Clamp a configuration to sane ranges and derive the fields the engine
+ * uses.  Returns -1 if the default match rule cannot be built.
+ */
+static int config_finish(struct config *cfg)
+{
+    /* Horizontal settings not overridden follow the vertical ones. */
+    for (size_t i = 0; i < NPARAMS; i++)
+    {
+        const struct param *p = &params[i];
+        if (param_horiz(p) && !(cfg->h_set & (1ULL << i)))
+            memcpy((char *)cfg + p->offset,
+                   (char *)cfg + p->offset - sizeof(struct axis_params),
+                   param_size(p));
+    }
+
+    for (int a = 0; a < AXIS_COUNT; a++)
+    {
+        struct axis_params *ap = &cfg->axis[a];
+
+        if (ap->friction < 0.01)
+            ap->friction = 0.01;
+        if (ap->friction > 0.2)
+            ap->friction = 0.2;
+        if (ap->multiplier < 0.01)
+            ap->multiplier = 0.01;
+        if (ap->multiplier > 10.0)
+            ap->multiplier = 10.0;
+        if (ap->reversal_damp < 0.0)
+            ap->reversal_damp = 0.0;
+        if (ap->reversal_damp > 1.0)
+            ap->reversal_damp = 1.0;
+        if (ap->spring_stiffness < 1.0)
+            ap->spring_stiffness = 1.0;
+        if (ap->spring_ms < 10)
+            ap->spring_ms = 10;
+        if (ap->spring_ms > 5000)
+            ap->spring_ms = 5000;
+
+        ap->decay_per_ns = log(1.0 - ap->friction) / (double)FRICTION_REF_NS;
+        ap->spring_omega_per_ns = sqrt(ap->spring_stiffness) / 1e9;
+
+        /* The spring has no integer implementation. */
+        ap->fixed = cfg->fixed_point && ap->model == MODEL_FRICTION;
+        fx_decay_build(ap->decay_q, ap->friction);
+        ap->stop_q = (int64_t)(ap->stop_threshold * (double)Q32_ONE);
+        ap->low_rate_q = (int64_t)(ap->low_rate * (double)Q16_ONE);
+        ap->high_rate_q = (int64_t)(ap->high_rate * (double)Q16_ONE);
+        ap->min_scale_q = (int64_t)(ap->min_scale * (double)Q16_ONE);
+        ap->multiplier_q = (int64_t)(ap->multiplier * (double)Q16_ONE);
+        ap->reversal_damp_q = (int64_t)(ap->reversal_damp * (double)Q16_ONE);
+    }
+
+    if (cfg->tick_ms < 1)
+        cfg->tick_ms = 1;
+    if (cfg->tick_ms > 50)
+        cfg->tick_ms = 50;
+
+    if (cfg->rate_window_ms < 10)
+        cfg->rate_window_ms = 10;
+    if (cfg->rate_window_ms > 5000)
+        cfg->rate_window_ms = 5000;
+    if (cfg->rate_ring_size < 2)
+        cfg->rate_ring_size = 2;
+    if (cfg->rate_ring_size > 4096)
+        cfg->rate_ring_size = 4096;
+    if (cfg->rt_priority < 1)
+        cfg->rt_priority = 1;
+    if (cfg->rt_priority > 99)
+        cfg->rt_priority = 99;
+
+    if (cfg->refresh_hz > 0.0)
+    {
+        if (cfg->refresh_hz < 10.0)
+            cfg->refresh_hz = 10.0;
+        if (cfg->refresh_hz > 1000.0)
+            cfg->refresh_hz = 1000.0;
+        cfg->scheduler = SCHEDULER_REFRESH;
+    }
+    else if (cfg->scheduler == SCHEDULER_REFRESH)
+        cfg->scheduler = SCHEDULER_FIXED;
+
+    if (cfg->nrules == 0 &&
+        match_add(&cfg->rules, &cfg->nrules, DEFAULT_MATCH_RULE) < 0)
+        return -1;
+    cfg->match_types = match_types(cfg->rules, cfg->nrules);
+    return 0;
+}
+
+/* ── Device contexts ──────────────────────────────────────────────────── */
+
+/*
+ * epoll_event.data.ptr points at one of these, embedded as the first
+ * member of whatever the ready fd belongs to.
+ */
+enum watch_kind
+{
+    WATCH_TIMER,
+    WATCH_HOTPLUG,
+    WATCH_DEVICE,
+    WATCH_CONTROL, /* control socket listener      */
+    WATCH_CLIENT,  /* control socket connection    */
+    WATCH_SIGNAL,  /* signalfd: SIGHUP, SIGUSR1    */
+    WATCH_READY,   /* udev wait deadline timer     */
+};
+
+struct watch
+{
+    enum watch_kind kind;
+};
+
+/*
+ * One smoothed source: the grabbed node, its virtual device, both axes
+ * and the read buffer.  The context outlives its source, so a node that
+ * comes back finds its virtual device and any glide still in place.
+ */
+struct device
+{
+    struct watch w; /* WATCH_DEVICE, must stay first */
+    struct source src;
+    struct mirror mirror;
+    struct axis_state vert;
+    struct axis_state horiz;
+
+    /*
+     * Track whether we forwarded any non-scroll events in the current
+     * frame.  We suppress SYN_REPORT after scroll-only frames so we
+     * don't emit empty syncs.
+     */
+    int had_non_scroll;
+
+    int active;            /* slot in the active list, -1 = at rest  */
+    const char *want_path; /* explicit DEVICE_PATH, NULL = auto      */
+    char name[256];        /* source name, to recognize a comeback   */
+    int64_t detached_ns;   /* when the source was lost, 0 = attached */
+    int dead;              /* removed, freed after the epoll batch   */
+    struct device *next_dead;
+};
+
+static struct device *device_new(const struct config *cfg,
+                                 const char *want_path)
+{
+    struct device *dev = calloc(1, sizeof(*dev));
+    if (!dev)
+    {
+        perror("calloc");
+        return NULL;
+    }
+    dev->w.kind = WATCH_DEVICE;
+    dev->src.fd = -1;
+    dev->mirror.out.fd = -1;
+    dev->active = -1;
+    dev->want_path = want_path;
+
+    int64_t window_ns = cfg->rate_window_ms * 1000000LL;
+    if (rate_init(&dev->vert.rate, cfg->rate_ring_size, window_ns) < 0 ||
+        rate_init(&dev->horiz.rate, cfg->rate_ring_size, window_ns) < 0)
+    {
+        perror("rate_init");
+        rate_free(&dev->vert.rate);
+        free(dev);
+        return NULL;
+    }
+    return dev;
+}
+
+static void device_free(struct device *dev)
+{
+    /* Ungrab source device so it becomes usable again. */
+    source_close(&dev->src);
+
+    /* Destroy the virtual device. */
+    mirror_destroy(&dev->mirror);
+
+    rate_free(&dev->vert.rate);
+    rate_free(&dev->horiz.rate);
+    free(dev);
+}
+
+static int device_moving(const struct device *dev)
+{
+    return axis_moving(&dev->vert) || axis_moving(&dev->horiz);
+}
+
+/* ── Event engine ─────────────────────────────────────────────────────── */
+
+/*
+ * Every device shares the one epoll loop and the one emission timer.
+ * Devices with a gliding axis sit on the active list, which is all a
+ * timer tick walks, so the per-tick cost follows the number of gliding
+ * devices rather than the number grabbed.
+ */
+struct engine
+{
+    struct config *cfg;
+    int epfd;
+    int tfd;
+    struct watch timer_w;   /* WATCH_TIMER   */
+    struct watch hotplug_w; /* WATCH_HOTPLUG */
+    struct hotplug hotplug;
+    struct watch control_w; /* WATCH_CONTROL */
+    int control_fd;
+    struct watch signal_w;  /* WATCH_SIGNAL  */
+    int sfd;
+    struct watch ready_w;   /* WATCH_READY   */
+    int ready_tfd;          /* earliest deadline of a pending device */
+    int live;               /* the event loop runs: never block      */
+
+    /*
+     * Per axis, the dampening table in use and a spare: a new curve is
+     * compiled into the spare, then the pointer flips between two events.
+     */
+    struct curve curves[AXIS_COUNT][2];
+    const struct curve *curve[AXIS_COUNT];
+    struct control_client *clients[CONTROL_MAX_CLIENTS];
+
+    struct device *devices[MAX_DEVICES];
+    int ndevices;
+    struct device *active[MAX_DEVICES];
+    int nactive;
+    struct device *dead; /* removed contexts, see engine_reap() */
+
+    int64_t tick_ns;
+    int64_t next_tick_ns; /* next scheduled tick (refresh: next frame) */
+    int64_t armed_ns;     /* what the timer was last armed for         */
+    int timer_armed;
+    struct frame_pll pll;
+    struct wakeup_stats wstats;
+    struct metrics metrics;
+};
+
+static void engine_activate(struct engine *eng, struct device *dev)
+{
+    if (dev->active >= 0)
+        return;
+    dev->active = eng->nactive;
+    eng->active[eng->nactive++] = dev;
+}
+
+static void engine_deactivate(struct engine *eng, struct device *dev)
+{
+    if (dev->active < 0)
+        return;
+    struct device *last = eng->active[--eng->nactive];
+    eng->active[dev->active] = last;
+    last->active = dev->active;
+    dev->active = -1;
+}
+
+/* Arm the emission timer for deadline_ns, remembered for the metrics. */
+static int engine_arm(struct engine *eng, int64_t deadline_ns)
+{
+    eng->armed_ns = deadline_ns;
+    return arm_timer(eng->tfd, deadline_ns);
+}
+
+/* Is the node at path already grabbed by one of our devices? */
+static int engine_holds(const struct engine *eng, const char *path)
+{
+    for (int i = 0; i < eng->ndevices; i++)
+    {
+        const struct device *dev = eng->devices[i];
+        if (dev->src.fd >= 0 && strcmp(dev->src.path, path) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+static struct device *engine_add(struct engine *eng, const char *want_path)
+{
+    if (eng->ndevices == MAX_DEVICES)
+    {
+        fprintf(stderr, "Too many devices (max %d).\n", MAX_DEVICES);
+        return NULL;
+    }
+    struct device *dev = device_new(eng->cfg, want_path);
+    if (dev)
+        eng->devices[eng->ndevices++] = dev;
+    return dev;
+}
+
+static void engine_remove(struct engine *eng, struct device *dev)
+{
+    engine_deactivate(eng, dev);
+    if (dev->src.fd >= 0)
+        epoll_ctl(eng->epfd, EPOLL_CTL_DEL, dev->src.fd, NULL);
+
+    eng->metrics.out_frames += dev->mirror.out.frames;
+    eng->metrics.out_syscalls += dev->mirror.out.syscalls;
+
+    for (int i = 0; i < eng->ndevices; i++)
+    {
+        if (eng->devices[i] == dev)
+        {
+            eng->devices[i] = eng->devices[--eng->ndevices];
+            break;
+        }
+    }
+
+    if (dev->name[0])
+        fprintf(stderr, "Removed device %s.\n", dev->name);
+
+    /*
+     * Ungrab and destroy the virtual device now, but keep the memory:
+     * the current epoll batch may still hold events for it.
+     */
+    source_close(&dev->src);
+    mirror_destroy(&dev->mirror);
+    dev->dead = 1;
+    dev->next_dead = eng->dead;
+    eng->dead = dev;
+
+    /*
+     * Nothing left to smooth and nothing that could bring a device back:
+     * give up and let systemd restart us.
+     */
+    if (eng->ndevices == 0 &&
+        (eng->hotplug.fd < 0 || eng->cfg->ndevice_paths))
+    {
+        g_running = 0;
+        g_device_error = 1;
+    }
+}
+
+/* Free the contexts removed since the last call, between epoll batches. */
+static void engine_reap(struct engine *eng)
+{
+    while (eng->dead)
+    {
+        struct device *dev = eng->dead;
+        eng->dead = dev->next_dead;
+        device_free(dev);
+    }
+}
+
+/*
+ * Pick the detached auto-detected context a new source replaces: the same
+ * device coming back (same name and capabilities), else one with the same
+ * capabilities, whose virtual device is kept, else one with the same name,
+ * whose virtual device gets rebuilt.  NULL means the source is new.
+ */
+static struct device *engine_find_detached(const struct engine *eng,
+                                           const struct source *src)
+{
+    struct dev_caps caps;
+    struct device *by_caps = NULL, *by_name = NULL;
+    const char *name = libevdev_get_name(src->evdev);
+
+    if (caps_read(src->fd, &caps) < 0)
+        return NULL;
+
+    for (int i = 0; i < eng->ndevices; i++)
+    {
+        struct device *dev = eng->devices[i];
+        if (dev->src.fd >= 0 || dev->want_path)
+            continue;
+
+        int same_caps = caps_diff(&dev->mirror.caps, &caps) == 0;
+        int same_name = name && strcmp(dev->name, name) == 0;
+        if (same_caps && same_name)
+            return dev;
+        if (same_caps && !by_caps)
+            by_caps = dev;
+        if (same_name && !by_name)
+            by_name = dev;
+    }
+    return by_caps ? by_caps : by_name;
+}
+
+/* When a pending virtual device stops waiting for udev, ready or not. */
+static int64_t mirror_ready_deadline(const struct mirror *m)
+{
+    int64_t ms = m->db[0] ? UDEV_READY_TIMEOUT_MS : UDEV_SETTLE_MS;
+    return m->created_ns + ms * 1000000LL;
+}
+
+/*
+ * Arm the udev wait timer for the earliest pending deadline, or disarm
+ * it when nothing is pending.
+ */
+static void engine_ready_arm(struct engine *eng)
+{
+    int64_t due = INT64_MAX;
+    for (int i = 0; i < eng->ndevices; i++)
+    {
+        const struct mirror *m = &eng->devices[i]->mirror;
+        if (m->pending && mirror_ready_deadline(m) < due)
+            due = mirror_ready_deadline(m);
+    }
+
+    if (due == INT64_MAX)
+        disarm_timer(eng->ready_tfd);
+    else
+        arm_timer(eng->ready_tfd, due);
+}
+
+/*
+ * Grab dev's open source and start polling it.  A failed grab closes the
+ * source; a context that never had one attached is dropped, others stay
+ * detached.  Returns 0 once the source is active.
+ */
+static int engine_grab(struct engine *eng, struct device *dev)
+{
+    struct source *src = &dev->src;
+
+    if (ioctl(src->fd, EVIOCGRAB, 1) < 0)
+    {
+        perror("EVIOCGRAB");
+        goto fail;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = &dev->w;
+    if (epoll_ctl(eng->epfd, EPOLL_CTL_ADD, src->fd, &ev) < 0)
+    {
+        perror("epoll_ctl src_fd");
+        goto fail;
+    }
+
+    if (dev->detached_ns)
+        fprintf(stderr, "Re-acquired source device %s.\n", src->path);
+    dev->detached_ns = 0;
+    snprintf(dev->name, sizeof(dev->name), "%s",
+             libevdev_get_name(src->evdev));
+    return 0;
+
+fail:
+    source_close(src);
+    if (!dev->detached_ns)
+        engine_remove(eng, dev);
+    return -1;
+}
+
+/*
+ * Open the node at path and have it grabbed, into dev when given (an
+ * explicit DEVICE_PATH), else into the detached context it replaces or a
+ * new one.  An existing virtual device is kept unless the capabilities
+ * differ.  A new virtual device must be processed by udev before the
+ * source is grabbed: at startup that is waited for here, but once the
+ * event loop runs the source is left pending and grabbed from
+ * engine_ready_check().  Returns 0 once the source is active or pending.
+ */
+static int engine_acquire(struct engine *eng, struct device *dev,
+                          const char *path)
+{
+    /* A lost explicit DEVICE_PATH is retried until its node is back. */
+    struct source src;
+    if (source_open(&src, path, dev && dev->detached_ns) < 0)
+        return -1;
+
+    if (!dev)
+        dev = engine_find_detached(eng, &src);
+    if (!dev)
+        dev = engine_add(eng, NULL);
+    if (!dev)
+    {
+        source_close(&src);
+        return -1;
+    }
+
+    int verbose = eng->cfg->verbose;
+    int rc = dev->mirror.out.fd < 0
+                 ? mirror_create(&dev->mirror, &src, verbose)
+                 : mirror_reconcile(&dev->mirror, &src, verbose);
+    if (rc < 0)
+    {
+        source_close(&src);
+        engine_remove(eng, dev);
+        return -1;
+    }
+
+    dev->src = src;
+    if (dev->mirror.pending && mirror_ready(&dev->mirror))
+        mirror_ready_report(&dev->mirror, 1);
+    if (dev->mirror.pending && !eng->live)
+        mirror_ready_report(&dev->mirror,
+                            mirror_wait_ready(&dev->mirror) == 0);
+    if (dev->mirror.pending)
+    {
+        engine_ready_arm(eng);
+        return 0;
+    }
+    return engine_grab(eng, dev);
+}
+
+/*
+ * Grab the sources whose virtual devices udev has processed, and those
+ * that waited past their deadline, then re-arm the udev wait timer.
+ * Called on udev database changes and when the timer expires.
+ */
+static void engine_ready_check(struct engine *eng)
+{
+    uint64_t expirations;
+    int64_t now = now_ns();
+
+    /* Non-blocking: nothing to read unless the timer went off. */
+    if (read(eng->ready_tfd, &expirations, sizeof(expirations)) < 0 &&
+        errno != EAGAIN)
+        perror("read ready timerfd");
+
+    /* Walk backwards: a failed grab may remove the current entry. */
+    for (int i = eng->ndevices - 1; i >= 0; i--)
+    {
+        struct device *dev = eng->devices[i];
+        struct mirror *m = &dev->mirror;
+        if (!m->pending)
+            continue;
+
+        if (mirror_ready(m))
+            mirror_ready_report(m, 1);
+        else if (now >= mirror_ready_deadline(m))
+            mirror_ready_report(m, m->db[0] == '\0');
+        else
+            continue;
+        engine_grab(eng, dev);
+    }
+    engine_ready_arm(eng);
+}
+
+/*
+ * Start smoothing every auto-detected scroll device not grabbed yet.
+ * Returns the number of devices acquired.
+ */
+static int engine_scan(struct engine *eng)
+{
+    char paths[MAX_DEVICES][280];
+    int scanned;
+    int64_t start = now_ns();
+    int n = find_scroll_devices(eng->cfg, paths, MAX_DEVICES, &scanned);
+    int acquired = 0;
+
+    if (eng->cfg->verbose)
+        fprintf(stderr, "[discovery] %d of %d input nodes match (%.1f us)\n",
+                n, scanned, (double)(now_ns() - start) / 1e3);
+
+    for (int i = 0; i < n; i++)
+    {
+        if (engine_holds(eng, paths[i]))
+            continue;
+        if (engine_acquire(eng, NULL, paths[i]) == 0)
+            acquired++;
+    }
+    return acquired;
+}
+
+/*
+ * Let go of the auto-detected devices the match rules no longer select,
+ * after the rules changed.  Explicit DEVICE_PATHs are never released.
+ */
+static void engine_release_unmatched(struct engine *eng)
+{
+    struct input_info info;
+
+    /* Walk backwards: engine_remove() moves the last entry here. */
+    for (int i = eng->ndevices - 1; i >= 0; i--)
+    {
+        struct device *dev = eng->devices[i];
+        if (dev->src.fd < 0 || dev->want_path)
+            continue;
+
+        const char *node = strrchr(dev->src.path, '/');
+        if (probe_scroll_device(eng->cfg, node ? node + 1 : dev->src.path,
+                                &info))
+            continue;
+        fprintf(stderr, "Releasing %s: no longer selected by the rules.\n",
+                dev->src.path);
+        engine_remove(eng, dev);
+    }
+}
+
+/*
+ * The device's source is gone: stop polling it, drop its torn frame and
+ * release the keys it left pressed.  The virtual device and the axis
+ * state (including any glide) stay alive while a replacement is looked
+ * for.
+ */
+static void engine_lost(struct engine *eng, struct device *dev)
+{
+    epoll_ctl(eng->epfd, EPOLL_CTL_DEL, dev->src.fd, NULL);
+    source_close(&dev->src);
+    dev->mirror.out.n = 0;
+    dev->had_non_scroll = 0;
+    dev->detached_ns = now_ns();
+
+    /* The replacement never sends the release of a key held now. */
+    if (mirror_sync_keys(&dev->mirror, NULL))
+        write_syn(&dev->mirror.out);
+
+    /* Without the hotplug watcher nothing would bring it back. */
+    if (eng->hotplug.fd < 0)
+    {
+        engine_remove(eng, dev);
+        return;
+    }
+
+    fprintf(stderr, "Waiting for %s to come back...\n", dev->name);
+
+    /* The replacement may have appeared before the old node failed. */
+    if (dev->want_path)
+        engine_acquire(eng, dev, dev->want_path);
+    else
+        engine_scan(eng);
+}
+
+/*
+ * Drain inotify events.  Each new or re-permissioned event* node is
+ * checked against the match rules through sysfs and, if selected and
+ * not held yet, acquired.  With explicit DEVICE_PATHs, a missing one is
+ * retried instead when an event names it or the node it links to.
+ * Auto-detected devices that stayed away too long are dropped, and a
+ * change in the udev database may let pending sources be grabbed.
+ */
+static void engine_hotplug(struct engine *eng)
+{
+    union
+    {
+        struct inotify_event ev;
+        char buf[4096];
+    } u;
+    char path[280];
+    struct input_info info;
+    int udev_changed = 0;
+    int relink = 0;
+    char retry[MAX_DEVICES] = {0};
+
+    while (1)
+    {
+        ssize_t n = read(eng->hotplug.fd, u.buf, sizeof(u.buf));
+        if (n <= 0)
+            break;
+
+        for (char *p = u.buf; p < u.buf + n;)
+        {
+            const struct inotify_event *ie = (const struct inotify_event *)p;
+            p += sizeof(*ie) + ie->len;
+
+            udev_changed |= ie->wd == eng->hotplug.udev_wd;
+
+            /* A link directory went away, or one may have come back. */
+            if (ie->mask & IN_IGNORED)
+            {
+                if (ie->wd == eng->hotplug.by_id_wd)
+                    eng->hotplug.by_id_wd = -1;
+                if (ie->wd == eng->hotplug.by_path_wd)
+                    eng->hotplug.by_path_wd = -1;
+                relink = 1;
+            }
+            else if (ie->wd == eng->hotplug.dev_wd && (ie->mask & IN_ISDIR))
+                relink = 1;
+
+            for (int i = 0; i < eng->ndevices; i++)
+            {
+                const struct device *dev = eng->devices[i];
+                if (dev->src.fd < 0 && dev->want_path &&
+                    hotplug_names(&eng->hotplug, ie, dev->want_path))
+                    retry[i] = 1;
+            }
+
+            if (eng->cfg->ndevice_paths || ie->wd != eng->hotplug.dev_wd ||
+                !ie->len || strncmp(ie->name, "event", 5) != 0)
+                continue;
+
+            snprintf(path, sizeof(path), "/dev/input/%s", ie->name);
+            if (!engine_holds(eng, path) &&
+                probe_scroll_device(eng->cfg, ie->name, &info))
+            {
+                fprintf(stderr, "Hotplugged device: %s (%s)\n", path,
+                        info.name);
+                engine_acquire(eng, NULL, path);
+            }
+        }
+    }
+
+    /* Links made before the directory was watched again were missed. */
+    if (relink && hotplug_watch_links(&eng->hotplug))
+        memset(retry, 1, sizeof(retry));
+
+    /* Walk backwards: a failed acquire removes the current entry. */
+    int64_t now = now_ns();
+    for (int i = eng->ndevices - 1; i >= 0; i--)
+    {
+        struct device *dev = eng->devices[i];
+        if (dev->src.fd >= 0)
+            continue;
+        if (dev->want_path)
+        {
+            if (retry[i])
+                engine_acquire(eng, dev, dev->want_path);
+        }
+        else if (dev->active < 0 &&
+                 now - dev->detached_ns >= DEVICE_LINGER_NS)
+            engine_remove(eng, dev);
+    }
+
+    if (udev_changed)
+        engine_ready_check(eng);
+}
+
+/*
+ * The device has input to glide on: put it on the active list and make
+ * sure the timer covers it.  In tickless mode new input moves the due
+ * time earlier, so the timer is re-armed while gliding too.
+ */
+static void engine_wake(struct engine *eng, struct device *dev, int64_t ts)
+{
+    const struct config *cfg = eng->cfg;
+
+    if (!device_moving(dev))
+        return;
+    engine_activate(eng, dev);
+
+    if (cfg->scheduler == SCHEDULER_REFRESH)
+    {
+        if (!eng->timer_armed)
+        {
+            eng->next_tick_ns = pll_next_frame(&eng->pll, ts);
+            if (engine_arm(eng, pll_arm_ns(&eng->pll, eng->next_tick_ns)) < 0)
+                perror("timerfd_settime");
+        }
+    }
+    else if (cfg->scheduler == SCHEDULER_TICKLESS)
+    {
+        int64_t deadline = tickless_deadline(&dev->vert, &dev->horiz, cfg,
+                                             ts + eng->tick_ns);
+        if (!eng->timer_armed || deadline < eng->next_tick_ns)
+        {
+            eng->next_tick_ns = deadline;
+            if (engine_arm(eng, eng->next_tick_ns) < 0)
+                perror("timerfd_settime");
+        }
+    }
+    else if (!eng->timer_armed)
+    {
+        eng->next_tick_ns =
+            next_on_grid(eng->next_tick_ns, eng->tick_ns, ts);
+        if (engine_arm(eng, eng->next_tick_ns) < 0)
+            perror("timerfd_settime");
+    }
+
+    if (!eng->timer_armed)
+    {
+        eng->timer_armed = 1;
+        /* A kernel event timestamp may predate the disarm. */
+        if (ts > eng->wstats.idle_since_ns)
+            eng->wstats.idle_total_ns += ts - eng->wstats.idle_since_ns;
+        eng->wstats.idle_since_ns = 0;
+    }
+}
+
+/* A scroll event from the device's source: feed it into its axis. */
+static void device_scroll(struct engine *eng, struct device *dev,
+                          const struct input_event *ev)
+{
+    const struct config *cfg = eng->cfg;
+    int64_t ts = dev->src.kernel_ts ? event_time_ns(ev) : now_ns();
+    double raw = 0.0;
+    struct axis_state *axis = NULL;
+    int id = AXIS_VERT;
+
+    switch (ev->code)
+    {
+    case REL_WHEEL:
+        raw = (double)ev->value * HIRES_PER_TICK;
+        axis = &dev->vert;
+        break;
+    case REL_HWHEEL:
+        raw = (double)ev->value * HIRES_PER_TICK;
+        axis = &dev->horiz;
+        id = AXIS_HORIZ;
+        break;
+    case REL_WHEEL_HI_RES:
+        raw = (double)ev->value;
+        axis = &dev->vert;
+        break;
+    case REL_HWHEEL_HI_RES:
+        raw = (double)ev->value;
+        axis = &dev->horiz;
+        id = AXIS_HORIZ;
+        break;
+    }
+
+    if (!axis)
+        return;
+    const struct axis_params *ap = &cfg->axis[id];
+
+    /*
+     * A gesture starting from rest begins one reference tick in the past,
+     * so the immediate emit below extracts a full tick of glide.
+     */
+    if (!axis_moving(axis))
+    {
+        axis->last_step_ns = ts - FRICTION_REF_NS;
+        axis->gesture_ns = ts;
+    }
+
+    if (!axis->input_ns)
+        axis->input_ns = ts;
+
+    /*
+     * Input against the glide: cancel or damp what is left of it and
+     * drop the sub-unit remainder, so the scroll turns with this event
+     * instead of drifting the old way for several more frames.
+     */
+    if (raw * axis_sign(axis) < 0.0)
+    {
+        axis->reversal_ns = ts;
+        axis->reversal_dir = raw > 0.0 ? 1 : -1;
+        if (ap->reversal != REVERSAL_ADD && ap->fixed)
+        {
+            int64_t keep =
+                ap->reversal == REVERSAL_DAMP ? ap->reversal_damp_q : 0;
+            axis->velocity_q = fx_mul(axis->velocity_q, (uint64_t)keep, 16);
+            axis->accum_q = 0;
+        }
+        else if (ap->reversal != REVERSAL_ADD)
+        {
+            double keep =
+                ap->reversal == REVERSAL_DAMP ? ap->reversal_damp : 0.0;
+            axis->velocity *= keep;
+            axis->spring_speed *= keep;
+            axis->emit_accum = 0.0;
+        }
+        if (ap->reversal != REVERSAL_ADD && !axis_moving(axis))
+            axis->last_step_ns = ts - FRICTION_REF_NS;
+    }
+
+    rate_record(&axis->rate, ts);
+    double rate, scale;
+    if (ap->fixed)
+    {
+        /* Q16.16 scale times Q16.16 multiplier: Q32.32 per unit. */
+        int64_t rate_q = rate_compute_q(&axis->rate, ts);
+        int64_t scale_q = compute_scale_q(rate_q, ap, eng->curve[id]);
+        axis->velocity_q += (int64_t)raw * scale_q * ap->multiplier_q;
+
+        /* For the trace only. */
+        rate = cfg->verbose ? (double)rate_q / (double)Q16_ONE : 0.0;
+        scale = cfg->verbose ? (double)scale_q / (double)Q16_ONE : 0.0;
+    }
+    else
+    {
+        rate = rate_compute(&axis->rate, ts);
+        scale = compute_scale(rate, ap, eng->curve[id]);
+        axis->velocity += raw * scale * ap->multiplier;
+    }
+    axis->last_input_ns = ts;
+    axis->target_sign = axis_sign(axis) > 0 ? 1 : -1;
+
+    if (cfg->verbose)
+    {
+        fprintf(stderr,
+                "[in] %s code=%u val=%d raw=%.0f rate=%.1f/s scale=%.3f "
+                "vel=%.1f\n",
+                dev->src.path, ev->code, ev->value, raw, rate, scale,
+                axis_velocity(axis));
+    }
+
+    unsigned short hc = id == AXIS_VERT ? REL_WHEEL_HI_RES : REL_HWHEEL_HI_RES;
+    const char *lbl = !cfg->verbose ? NULL : id == AXIS_VERT ? "vert" : "horiz";
+
+    /*
+     * Refresh-locked: defer to the next frame so every display frame gets
+     * exactly one coalesced report.  The frame still applies the minimum
+     * step for this input.
+     */
+    if (cfg->scheduler == SCHEDULER_REFRESH)
+    {
+        axis->pending_input = 1;
+    }
+    else
+    {
+        /*
+         * Emit immediately on new input for sharp initial response.
+         * Without this, the first scroll impulse waits up to one tick
+         * interval before anything appears on screen, making the start of
+         * a scroll feel soft/laggy compared to native macOS.  The timer
+         * continues handling the deceleration coast.
+         */
+        struct out_frame *out = &dev->mirror.out;
+        int did_emit = emit_axis(out, axis, hc, ap, lbl, ts);
+        if (!did_emit)
+            did_emit = emit_min_step(out, axis, hc, ap, lbl);
+
+        /*
+         * The report also carries any events forwarded earlier in this
+         * source frame, so the source SYN needs no second one.
+         */
+        if (did_emit)
+        {
+            write_syn(out);
+            dev->had_non_scroll = 0;
+            int64_t written = now_ns();
+            latency_record(&eng->metrics, axis, written);
+            reversal_record(&eng->metrics, axis, written);
+        }
+        settle_record(&eng->metrics, axis, ts);
+    }
+
+    /* Wake the timer for the deceleration coast. */
+    engine_wake(eng, dev, ts);
+}
+
+static void device_event(struct engine *eng, struct device *dev,
+                         const struct input_event *ev)
+{
+    /* SYN_REPORT: flush only if we forwarded non-scroll. */
+    if (ev->type == EV_SYN && ev->code == SYN_REPORT)
+    {
+        if (dev->had_non_scroll)
+            write_syn(&dev->mirror.out);
+        dev->had_non_scroll = 0;
+        return;
+    }
+
+    /* Intercept scroll events. */
+    if (ev->type == EV_REL && is_scroll_code(ev->code))
+    {
+        device_scroll(eng, dev, ev);
+        return;
+    }
+
+    /* Forward all other events immediately. */
+    write_event(&dev->mirror.out, ev->type, ev->code, ev->value);
+    dev->had_non_scroll = 1;
+}
+
+/*
+ * The kernel dropped events (SYN_DROPPED): the frame in progress is
+ * torn, so its queued output is discarded, and libevdev's resync
+ * (LIBEVDEV_READ_FLAG_SYNC) brings its view of the source up to date.
+ * Its delta events are relative to a state that included the torn
+ * frame, so they are not forwarded as-is; instead every key whose state
+ * on the virtual device differs from the source's is pressed or
+ * released, and axis and switch values are restated (the input core
+ * drops unchanged ones).  Multitouch slots are left to the next frame.
+ */
+static void device_resync(struct engine *eng, struct device *dev)
+{
+    struct libevdev *evdev = dev->src.evdev;
+    const struct dev_caps *caps = &dev->mirror.caps;
+    struct out_frame *out = &dev->mirror.out;
+    struct input_event ev;
+    int deltas = 0;
+
+    eng->metrics.in_dropped++;
+    out->n = 0;
+    dev->had_non_scroll = 0;
+
+    while (libevdev_next_event(evdev, LIBEVDEV_READ_FLAG_SYNC, &ev) ==
+           LIBEVDEV_READ_STATUS_SYNC)
+        deltas++;
+
+    int fixed = mirror_sync_keys(&dev->mirror, evdev);
+
+    static const unsigned int restate[] = {EV_ABS, EV_SW};
+    for (size_t t = 0; t < sizeof(restate) / sizeof(restate[0]); t++)
+    {
+        unsigned int type = restate[t];
+        for (size_t w = 0; w < NLONGS(KEY_CNT); w++)
+        {
+            for (unsigned long bits = caps->bits[type][w]; bits;
+                 bits &= bits - 1)
+            {
+                unsigned int code =
+                    (unsigned int)(w * LONG_BITS) + __builtin_ctzl(bits);
+                if (type == EV_ABS && code >= ABS_MT_SLOT)
+                    break;
+                write_event(out, (unsigned short)type, (unsigned short)code,
+                            libevdev_get_event_value(evdev, type, code));
+            }
+        }
+    }
+    write_syn(out);
+
+    fprintf(stderr,
+            "Source device %s dropped events; resynced (%d deltas, %d keys "
+            "fixed).\n",
+            dev->src.path, deltas, fixed);
+}
+
+/*
+ * The device's source is readable.  libevdev reads the kernel queue in
+ * bulk and hands the events out one at a time, handling SYN_DROPPED.
+ */
+static void device_read(struct engine *eng, struct device *dev)
+{
+    struct input_event ev;
+    uint64_t count = 0;
+    int rc;
+
+    while ((rc = libevdev_next_event(dev->src.evdev,
+                                     LIBEVDEV_READ_FLAG_NORMAL, &ev)) >= 0)
+    {
+        if (rc == LIBEVDEV_READ_STATUS_SYNC)
+        {
+            device_resync(eng, dev);
+            continue;
+        }
+        count++;
+        device_event(eng, dev, &ev);
+    }
+
+    if (count)
+    {
+        eng->metrics.in_reads++;
+        eng->metrics.in_events += count;
+    }
+
+    if (rc == -EAGAIN)
+        return;
+
+    /* Device gone (hot-unplug). */
+    fprintf(stderr, "Source device %s read error: %s\n", dev->src.path,
+            strerror(-rc));
+    engine_lost(eng, dev);
+}
+
+/* Emit one frame of glide for a gliding device. */
+static void device_frame(struct engine *eng, struct device *dev, int64_t now)
+{
+    const struct config *cfg = eng->cfg;
+    struct out_frame *out = &dev->mirror.out;
+    struct axis_state *vert = &dev->vert;
+    struct axis_state *horiz = &dev->horiz;
+    const struct axis_params *vp = &cfg->axis[AXIS_VERT];
+    const struct axis_params *hp = &cfg->axis[AXIS_HORIZ];
+    const char *vl = cfg->verbose ? "vert" : NULL;
+    const char *hl = cfg->verbose ? "horiz" : NULL;
+
+    int emit_v = emit_axis(out, vert, REL_WHEEL_HI_RES, vp, vl, now);
+    int emit_h = emit_axis(out, horiz, REL_HWHEEL_HI_RES, hp, hl, now);
+
+    /* Refresh-locked frames carry the deferred minimum steps. */
+    if (vert->pending_input && !emit_v)
+        emit_v = emit_min_step(out, vert, REL_WHEEL_HI_RES, vp, vl);
+    if (horiz->pending_input && !emit_h)
+        emit_h = emit_min_step(out, horiz, REL_HWHEEL_HI_RES, hp, hl);
+    vert->pending_input = 0;
+    horiz->pending_input = 0;
+
+    if (emit_v || emit_h)
+    {
+        write_syn(out);
+        if (vert->input_ns || horiz->input_ns || vert->reversal_ns ||
+            horiz->reversal_ns)
+        {
+            int64_t written = now_ns();
+            if (emit_v)
+            {
+                latency_record(&eng->metrics, vert, written);
+                reversal_record(&eng->metrics, vert, written);
+            }
+            if (emit_h)
+            {
+                latency_record(&eng->metrics, horiz, written);
+                reversal_record(&eng->metrics, horiz, written);
+            }
+        }
+    }
+    settle_record(&eng->metrics, vert, now);
+    settle_record(&eng->metrics, horiz, now);
+}
+
+/* Tickless: the earliest due time over every gliding device. */
+static int64_t engine_deadline(const struct engine *eng, int64_t earliest)
+{
+    int64_t deadline = INT64_MAX;
+    for (int i = 0; i < eng->nactive; i++)
+    {
+        const struct device *dev = eng->active[i];
+        int64_t due =
+            tickless_deadline(&dev->vert, &dev->horiz, eng->cfg, earliest);
+        if (due < deadline)
+            deadline = due;
+    }
+    return deadline;
+}
+
+/* Timer tick: emit smooth scroll on every gliding device. */
+static void engine_tick(struct engine *eng)
+{
+    const struct config *cfg = eng->cfg;
+    uint64_t expirations;
+    ssize_t n = read(eng->tfd, &expirations, sizeof(expirations));
+    if (n < 0 && errno != EAGAIN)
+    {
+        perror("read timerfd");
+        return;
+    }
+
+    eng->wstats.timer++;
+    eng->wstats.window_timer++;
+    eng->wstats.cur_timer++;
+
+    /*
+     * Physics integrates over the real elapsed time, so the expiration
+     * count does not matter: merged ticks are caught up in this single
+     * step.
+     */
+    int64_t now = now_ns();
+    hist_record(&eng->metrics.lateness, now - eng->armed_ns);
+
+    for (int i = 0; i < eng->nactive;)
+    {
+        struct device *dev = eng->active[i];
+        device_frame(eng, dev, now);
+        if (device_moving(dev))
+            i++;
+        else
+            engine_deactivate(eng, dev);
+    }
+
+    int64_t next_frame_ns = 0;
+    if (cfg->scheduler == SCHEDULER_REFRESH)
+        next_frame_ns = pll_update(&eng->pll, eng->next_tick_ns, now);
+
+    /*
+     * Every device at rest: disarm instead of rescheduling, so an idle
+     * daemon takes no wakeups until the next scroll.
+     */
+    if (eng->nactive == 0)
+    {
+        disarm_timer(eng->tfd);
+        eng->timer_armed = 0;
+        eng->wstats.idle_since_ns = now;
+        wakeup_gesture_end(&eng->wstats, cfg->verbose);
+        return;
+    }
+
+    /* Reschedule the next tick as an absolute time. */
+    if (cfg->scheduler == SCHEDULER_REFRESH)
+    {
+        eng->next_tick_ns = next_frame_ns;
+        engine_arm(eng, pll_arm_ns(&eng->pll, eng->next_tick_ns));
+        return;
+    }
+    if (cfg->scheduler == SCHEDULER_TICKLESS)
+        eng->next_tick_ns =
+            engine_deadline(eng, eng->next_tick_ns + eng->tick_ns);
+    else
+        eng->next_tick_ns += eng->tick_ns;
+    engine_arm(eng, eng->next_tick_ns);
+}
+
+/* Re-arm the running timer for the current scheduler, from now on. */
+static void engine_rearm(struct engine *eng, int64_t now)
+{
+    if (eng->cfg->scheduler == SCHEDULER_REFRESH)
+    {
+        eng->next_tick_ns = pll_next_frame(&eng->pll, now);
+        engine_arm(eng, pll_arm_ns(&eng->pll, eng->next_tick_ns));
+        return;
+    }
+    if (eng->cfg->scheduler == SCHEDULER_TICKLESS)
+        eng->next_tick_ns = engine_deadline(eng, now + eng->tick_ns);
+    else
+        eng->next_tick_ns = now + eng->tick_ns;
+    engine_arm(eng, eng->next_tick_ns);
+}
+
+/*
+ * Swap in a new configuration between frames.  Devices, their virtual
+ * devices, axis momentum and rate history all carry over; only the state
+ * derived from what changed is rebuilt.  next must have been through
+ * config_finish(); its rule list replaces (and frees) the current one.
+ */
+static void engine_apply_config(struct engine *eng, const struct config *next)
+{
+    struct config old = *eng->cfg;
+    struct config *cfg = eng->cfg;
+    int rules_changed =
+        !match_same(old.rules, old.nrules, next->rules, next->nrules);
+
+    *cfg = *next;
+    if (cfg->rules != old.rules)
+        match_free_all(old.rules, old.nrules);
+
+    if (cfg->rate_ring_size != old.rate_ring_size ||
+        cfg->rate_window_ms != old.rate_window_ms)
+    {
+        int64_t window_ns = cfg->rate_window_ms * 1000000LL;
+        for (int i = 0; i < eng->ndevices; i++)
+        {
+            struct device *dev = eng->devices[i];
+            if (rate_resize(&dev->vert.rate, cfg->rate_ring_size,
+                            window_ns) < 0 ||
+                rate_resize(&dev->horiz.rate, cfg->rate_ring_size,
+                            window_ns) < 0)
+                perror("rate_resize");
+        }
+    }
+
+    for (int a = 0; a < AXIS_COUNT; a++)
+    {
+        char *spec = cfg->axis[a].curve;
+        const char *was = old.axis[a].curve;
+        if (strcmp(spec, was) == 0)
+            continue;
+
+        struct curve *spare = eng->curve[a] == &eng->curves[a][0]
+                                  ? &eng->curves[a][1]
+                                  : &eng->curves[a][0];
+        char err[256];
+        if (curve_compile(spare, spec, err, sizeof(err)) == 0)
+            eng->curve[a] = spare;
+        else
+        {
+            fprintf(stderr, "%s\n", err);
+            strcpy(spec, was);
+        }
+    }
+
+    /* Axes switching in or out of --fixed-point keep their glides. */
+    for (int a = 0; a < AXIS_COUNT; a++)
+    {
+        if (cfg->axis[a].fixed == old.axis[a].fixed)
+            continue;
+        for (int i = 0; i < eng->ndevices; i++)
+        {
+            struct axis_state *as = a == AXIS_VERT ? &eng->devices[i]->vert
+                                                   : &eng->devices[i]->horiz;
+            if (cfg->axis[a].fixed)
+                fx_load(as);
+            else
+                fx_unload(as);
+        }
+    }
+
+    eng->tick_ns = cfg->tick_ms * 1000000LL;
+    if (cfg->scheduler == SCHEDULER_REFRESH &&
+        (old.scheduler != SCHEDULER_REFRESH ||
+         cfg->refresh_hz != old.refresh_hz ||
+         cfg->phase_offset_us != old.phase_offset_us))
+        pll_init(&eng->pll, cfg);
+
+    /* Friction, multiplier and cadence all move the next due time. */
+    if (eng->timer_armed)
+        engine_rearm(eng, now_ns());
+
+    if (cfg->realtime &&
+        (!old.realtime || cfg->rt_priority != old.rt_priority ||
+         cfg->rt_cpu != old.rt_cpu))
+        enter_realtime(cfg);
+    else if (!cfg->realtime && old.realtime)
+        leave_realtime();
+
+    /*
+     * New rules may select devices that are already present, and may drop
+     * or ignore ones that are grabbed.  Scan first so that swapping one
+     * device for another never leaves the daemon with none.
+     */
+    if (rules_changed && !cfg->ndevice_paths)
+    {
+        engine_scan(eng);
+        engine_release_unmatched(eng);
+    }
+}
+
+/* ── Control socket ───────────────────────────────────────────────────── */
+
+/*
+ * --control-socket: a line-oriented text protocol on a Unix stream socket
+ * for tuning a running daemon, e.g. with socat or nc -U:
+ *
+ *   list                  every parameter as "name = value"
+ *   get NAME              one parameter
+ *   set NAME=VALUE ...    change parameters; match=... takes the rest of
+ *                         the line, with rules separated by ';'
+ *
+ * Every reply ends with a line "ok" or "error: REASON".  A set is checked
+ * as a whole and applied from the event loop between two frames, so no
+ * frame ever runs with half of a change.
+ */
+#define CONTROL_LINE_MAX 1024
+#define CONTROL_REPLY_MAX 8192
+
+struct control_client
+{
+    struct watch w; /* WATCH_CLIENT, must stay first */
+    int fd;
+    size_t len; /* bytes of an unfinished line in buf */
+    char buf[CONTROL_LINE_MAX];
+};
+
+struct reply
+{
+    size_t len;
+    char buf[CONTROL_REPLY_MAX];
+};
+
+static void reply_printf(struct reply *r, const char *fmt, ...)
+{
+    va_list ap;
+    if (r->len >= sizeof(r->buf) - 1)
+        return;
+    va_start(ap, fmt);
+    int n = vsnprintf(r->buf + r->len, sizeof(r->buf) - r->len, fmt, ap);
+    va_end(ap);
+    if (n > 0)
+        r->len += (size_t)n;
+    if (r->len > sizeof(r->buf) - 1)
+        r->len = sizeof(r->buf) - 1;
+}
+
+/*
+ * Remove a socket left at path.  Anything else there is refused rather
+ * than deleted: the daemon runs as root and the path is configurable.
+ */
+static int control_unlink(const char *path)
+{
+    struct stat st;
+    if (lstat(path, &st) < 0)
+    {
+        if (errno == ENOENT)
+            return 0;
+        perror(path);
+        return -1;
+    }
+    if (!S_ISSOCK(st.st_mode))
+    {
+        fprintf(stderr, "Control socket: %s exists and is not a socket\n",
+                path);
+        return -1;
+    }
+    if (unlink(path) < 0)
+    {
+        perror(path);
+        return -1;
+    }
+    return 0;
+}
+
+static int control_open(struct engine *eng, const char *path)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "Control socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    /* A socket left behind by a previous run would make bind() fail. */
+    if (control_unlink(path) < 0)
+        return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        perror("socket");
+        return -1;
+    }
+
+    /* Only root may connect: the socket changes realtime settings too. */
+    mode_t mask = umask(0077);
+    int rc = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    umask(mask);
+    if (rc < 0 || listen(fd, CONTROL_MAX_CLIENTS) < 0)
+    {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = &eng->control_w;
+    if (epoll_ctl(eng->epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+    {
+        perror("epoll_ctl control");
+        close(fd);
+        control_unlink(path);
+        return -1;
+    }
+
+    eng->control_fd = fd;
+    fprintf(stderr, "Control socket: %s\n", path);
+    return 0;
+}
+
+static void control_drop(struct engine *eng, struct control_client *c)
+{
+    epoll_ctl(eng->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    for (int i = 0; i < CONTROL_MAX_CLIENTS; i++)
+        if (eng->clients[i] == c)
+            eng->clients[i] = NULL;
+    free(c);
+}
+
+static void control_close(struct engine *eng)
+{
+    for (int i = 0; i < CONTROL_MAX_CLIENTS; i++)
+        if (eng->clients[i])
+            control_drop(eng, eng->clients[i]);
+    if (eng->control_fd >= 0)
+    {
+        close(eng->control_fd);
+        control_unlink(eng->cfg->control_path);
+    }
+}
+
+static void control_accept(struct engine *eng)
+{
+    int fd;
+    while ((fd = accept4(eng->control_fd, NULL, NULL,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+    {
+        int slot = 0;
+        while (slot < CONTROL_MAX_CLIENTS && eng->clients[slot])
+            slot++;
+
+        struct control_client *c = NULL;
+        if (slot < CONTROL_MAX_CLIENTS)
+            c = calloc(1, sizeof(*c));
+        if (!c)
+        {
+            fprintf(stderr, "Control socket: connection refused.\n");
+            close(fd);
+            continue;
+        }
+        c->w.kind = WATCH_CLIENT;
+        c->fd = fd;
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = &c->w;
+        if (epoll_ctl(eng->epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+        {
+            perror("epoll_ctl control client");
+            close(fd);
+            free(c);
+            continue;
+        }
+        eng->clients[slot] = c;
+    }
+}
+
+/*
+ * set NAME=VALUE ...: parse every assignment into a copy of the running
+ * configuration and only swap it in when all of them are valid.
+ */
+static int control_set(struct engine *eng, char *args, struct reply *r)
+{
+    struct config next = *eng->cfg;
+    char err[256];
+    int n = 0;
+    int scheduler = -1; /* as asked for, before refresh-hz has its say */
+
+    while (*(args += strspn(args, " \t")))
+    {
+        size_t len = strcspn(args, "= \t");
+        if (args[len] != '=')
+        {
+            snprintf(err, sizeof(err), "expected NAME=VALUE, got '%.*s'",
+                     (int)len, args);
+            goto fail;
+        }
+        char *name = args;
+        char *value = args + len + 1;
+        name[len] = '\0';
+        const struct param *p = param_find(name);
+
+        /* Rules may contain spaces: match= takes the rest of the line. */
+        if (p && p->type == PARAM_MATCH)
+            args = value + strlen(value);
+        else
+        {
+            args = value + strcspn(value, " \t");
+            if (*args)
+                *args++ = '\0';
+        }
+
+        if (!p)
+        {
+            snprintf(err, sizeof(err), "unknown parameter '%s'", name);
+            goto fail;
+        }
+        if (param_set(&next, p, value, err, sizeof(err)) < 0)
+            goto fail;
+        if (p->type == PARAM_SCHEDULER)
+            scheduler = next.scheduler;
+        n++;
+    }
+    if (n == 0)
+    {
+        snprintf(err, sizeof(err), "nothing to set");
+        goto fail;
+    }
+    if (config_finish(&next) < 0)
+    {
+        snprintf(err, sizeof(err), "cannot build the default match rule");
+        goto fail;
+    }
 
-    ssize_t n = write(uifd, &ev, sizeof(ev));
-    if (n < 0)
+    /* Never reply ok to a scheduler that refresh-hz would override. */
+    if (scheduler >= 0 && (int)next.scheduler != scheduler)
     {
-        perror("write uinput event");
-        return -1;
+        if (scheduler == SCHEDULER_REFRESH)
+            snprintf(err, sizeof(err),
+                     "scheduler: refresh needs refresh-hz to be set");
+        else
+            snprintf(err, sizeof(err),
+                     "scheduler: refresh-hz=%g overrides it, set "
+                     "refresh-hz=0 as well", next.refresh_hz);
+        goto fail;
     }
+
+    engine_apply_config(eng, &next);
+    reply_printf(r, "ok\n");
     return 0;
-}
 
-static int write_syn(int uifd)
-{
-    return write_event(uifd, EV_SYN, SYN_REPORT, 0);
+fail:
+    if (next.rules != eng->cfg->rules)
+        match_free_all(next.rules, next.nrules);
+    reply_printf(r, "error: %s\n", err);
+    return -1;
 }
 
-static int is_scroll_code(unsigned short code)
+static void control_command(struct engine *eng, char *line, struct reply *r)
 {
-    return code == REL_WHEEL || code == REL_HWHEEL ||
-           code == REL_WHEEL_HI_RES || code == REL_HWHEEL_HI_RES;
+    char value[CONTROL_REPLY_MAX / 2];
+    char logged[CONTROL_LINE_MAX];
+
+    /* Tolerate CRLF and trailing blanks from interactive clients. */
+    for (char *end = line + strlen(line);
+         end > line && isspace((unsigned char)end[-1]);)
+        *--end = '\0';
+    line += strspn(line, " \t");
+    snprintf(logged, sizeof(logged), "%s", line);
+
+    size_t len = strcspn(line, " \t");
+    char *args = line + len;
+    if (*args)
+        *args++ = '\0';
+    args += strspn(args, " \t");
+
+    if (!*line)
+        return;
+
+    if (strcmp(line, "list") == 0)
+    {
+        for (size_t i = 0; i < NPARAMS; i++)
+        {
+            param_format(eng->cfg, &params[i], value, sizeof(value));
+            reply_printf(r, "%s = %s\n", params[i].name, value);
+        }
+        reply_printf(r, "ok\n");
+    }
+    else if (strcmp(line, "get") == 0)
+    {
+        const struct param *p = param_find(args);
+        if (!p)
+        {
+            reply_printf(r, "error: unknown parameter '%s'\n", args);
+            return;
+        }
+        param_format(eng->cfg, p, value, sizeof(value));
+        reply_printf(r, "%s = %s\nok\n", p->name, value);
+    }
+    else if (strcmp(line, "set") == 0)
+    {
+        if (control_set(eng, args, r) == 0)
+            fprintf(stderr, "Control: %s\n", logged);
+    }
+    else
+        reply_printf(r, "error: unknown command '%s' (list, get, set)\n",
+                     line);
 }
 
-/*
- * Perform one emission step for a single axis: apply friction-based
- * exponential decay, accumulate into sub-pixel remainder, and emit
- * the integer part as a hi-res scroll event.
- *
- * Also emits the corresponding low-res event (REL_WHEEL / REL_HWHEEL)
- * every time the hi-res accumulator crosses a 120-unit boundary.  This
- * is the standard Linux kernel convention: devices that send
- * REL_WHEEL_HI_RES must also send REL_WHEEL for compatibility with
- * applications that only handle the low-res variant.
- *
- * Returns 1 if any event was written, 0 otherwise.
- */
-static int emit_axis(int uifd, struct axis_state *as, unsigned short hires_code,
-                     const struct config *cfg, const char *label)
+/* Read from a control connection and answer every complete line. */
+static void control_read(struct engine *eng, struct control_client *c)
 {
-    if (fabs(as->velocity) < cfg->stop_threshold)
+    struct reply r;
+    r.len = 0;
+
+    ssize_t n = read(c->fd, c->buf + c->len, sizeof(c->buf) - c->len);
+    if (n <= 0)
     {
-        as->velocity = 0.0;
-        as->emit_accum = 0.0;
-        as->lowres_accum = 0;
-        return 0;
+        if (n < 0 && errno == EAGAIN)
+            return;
+        control_drop(eng, c);
+        return;
     }
+    c->len += (size_t)n;
 
-    /* Exponential decay: friction removes a fraction each tick. */
-    double old_vel = as->velocity;
-    as->velocity *= (1.0 - cfg->friction);
-    double emit = old_vel - as->velocity;
+    char *line = c->buf, *nl;
+    while ((nl = memchr(line, '\n', c->len - (size_t)(line - c->buf))))
+    {
+        *nl = '\0';
+        control_command(eng, line, &r);
+        line = nl + 1;
+    }
+    c->len -= (size_t)(line - c->buf);
+    memmove(c->buf, line, c->len);
+    if (c->len == sizeof(c->buf))
+    {
+        reply_printf(&r, "error: line too long\n");
+        c->len = 0;
+    }
 
-    /*
-     * Sub-pixel accumulation: accumulate the fractional hi-res
-     * units and only emit the integer part.  This prevents
-     * uneven step sizes that appear as micro-stutter.
-     */
-    as->emit_accum += emit;
-    int emit_int = (int)as->emit_accum;
-    as->emit_accum -= (double)emit_int;
+    /* Replies are small; a client that does not read them is dropped. */
+    if (r.len && send(c->fd, r.buf, r.len, MSG_NOSIGNAL | MSG_DONTWAIT) < 0)
+        control_drop(eng, c);
+}
 
-    if (emit_int != 0)
-    {
-        write_event(uifd, EV_REL, hires_code, emit_int);
+/* ── Statistics report ────────────────────────────────────────────────── */
 
-        /*
-         * Low-res compatibility: accumulate hi-res units and emit
-         * REL_WHEEL/REL_HWHEEL every 120 units.  Many applications
-         * (Firefox, Electron, older X11 toolkits) only handle the
-         * low-res event codes.
-         */
-        unsigned short lowres_code =
-            (hires_code == REL_WHEEL_HI_RES) ? REL_WHEEL : REL_HWHEEL;
-        as->lowres_accum += emit_int;
-        while (as->lowres_accum >= HIRES_PER_TICK)
-        {
-            write_event(uifd, EV_REL, lowres_code, 1);
-            as->lowres_accum -= HIRES_PER_TICK;
-        }
-        while (as->lowres_accum <= -HIRES_PER_TICK)
-        {
-            write_event(uifd, EV_REL, lowres_code, -1);
-            as->lowres_accum += HIRES_PER_TICK;
-        }
+static void print_stats(const struct engine *eng)
+{
+    const struct config *cfg = eng->cfg;
+    const struct metrics *m = &eng->metrics;
+    uint64_t frames = m->out_frames;
+    uint64_t syscalls = m->out_syscalls;
+    int attached = 0;
 
-        if (cfg->verbose)
-        {
-            fprintf(stderr,
-                    "[emit] %s hires=%d vel=%.1f accum=%.3f "
-                    "lowres_accum=%d\n",
-                    label, emit_int, as->velocity, as->emit_accum,
-                    as->lowres_accum);
-        }
-        return 1;
+    for (int i = 0; i < eng->ndevices; i++)
+    {
+        const struct device *dev = eng->devices[i];
+        frames += dev->mirror.out.frames;
+        syscalls += dev->mirror.out.syscalls;
+        attached += dev->src.fd >= 0;
     }
-    return 0;
+
+    wakeup_summary(&eng->wstats, now_ns(), scheduler_names[cfg->scheduler]);
+    fprintf(stderr, "Devices: %d, %d attached, %d gliding\n",
+            eng->ndevices, attached, eng->nactive);
+    if (m->in_reads)
+        fprintf(stderr,
+                "Input: %llu events, %.1f per wakeup, %llu buffer "
+                "overruns\n",
+                (unsigned long long)m->in_events,
+                (double)m->in_events / (double)m->in_reads,
+                (unsigned long long)m->in_dropped);
+    out_summary(frames, syscalls);
+    if (cfg->scheduler == SCHEDULER_REFRESH)
+        pll_summary(&eng->pll);
+    hist_print("Input-to-output latency", &m->latency);
+    hist_print("Tick lateness", &m->lateness);
+    hist_print("Time to settle", &m->settle);
+    hist_print("Reversal to output", &m->reversal);
+    enum physics_model vm = cfg->axis[AXIS_VERT].model;
+    enum physics_model hm = cfg->axis[AXIS_HORIZ].model;
+    fprintf(stderr, "Overshoot (%s%s%s): %llu of %llu glides",
+            model_names[vm], vm == hm ? "" : "/",
+            vm == hm ? "" : model_names[hm],
+            (unsigned long long)m->overshoots,
+            (unsigned long long)m->settle.count);
+    if (m->overshoots)
+        fprintf(stderr, ", max %.1f, mean %.1f hi-res units",
+                m->overshoot_max, m->overshoot_sum / (double)m->overshoots);
+    fputc('\n', stderr);
 }
 
 /* ── Usage ────────────────────────────────────────────────────────────── */
@@ -510,500 +4727,650 @@ static int emit_axis(int uifd, struct axis_state *as, unsigned short hires_code,
 static void print_usage(const char *progname)
 {
     fprintf(stderr,
-            "Usage: %s [OPTIONS] [DEVICE_PATH]\n\n"
-            "Smooth scroll daemon for Linux VMs (SPICE/QEMU/VirtIO).\n\n"
+            "Usage: %s [OPTIONS] [DEVICE_PATH...]\n\n"
+            "Smooth scroll daemon for Linux VMs (SPICE/QEMU/VirtIO).\n"
+            "Without DEVICE_PATH, every SPICE/QEMU/VirtIO scroll device is smoothed.\n\n"
             "Options:\n"
-            "  -f, --friction FLOAT       Per-tick friction factor, 0.01-0.2 (default: %.2f)\n"
+            "      --model MODEL          Glide physics: 'friction' decays an impulse\n"
+            "                             exponentially, 'spring' animates to the target\n"
+            "                             with a critically damped spring (default: friction)\n"
+            "  -f, --friction FLOAT       Friction per 4 ms of glide, 0.01-0.2 (default: %.2f)\n"
             "                             Lower = longer glide after release, higher = stops faster.\n"
             "                             macOS feel is around 0.02-0.04.\n"
-            "  -t, --tick-ms INT          Timer tick interval in ms (default: %d)\n"
+            "      --spring-stiffness FLOAT\n"
+            "                             Spring constant in 1/s^2 for --model spring;\n"
+            "                             higher = snappier (default: %.0f)\n"
+            "      --spring-ms INT        Longest a notch may take to settle with\n"
+            "                             --model spring (default: %d)\n"
+            "      --reversal POLICY      Input against a glide: 'add' the opposite impulse,\n"
+            "                             'cancel' the glide or 'damp' it (default: add)\n"
+            "      --reversal-damp FLOAT  Share of the glide kept by --reversal damp,\n"
+            "                             0-1 (default: %.2f)\n"
+            "      --h-OPTION VALUE       Horizontal axis only: --h-model, --h-friction,\n"
+            "                             --h-multiplier and the other physics options\n"
+            "                             (default: same as the vertical value)\n"
+            "  -t, --tick-ms INT          Output tick interval in ms (default: %d)\n"
+            "                             Only changes cadence, not scroll distance.\n"
+            "      --scheduler MODE       Glide timer scheduling: 'fixed' wakes every tick,\n"
+            "                             'tickless' wakes only when the next hi-res unit\n"
+            "                             is due, 'refresh' follows --refresh-hz\n"
+            "                             (default: fixed)\n"
+            "      --refresh-hz FLOAT     Lock emission to the display refresh rate (e.g. 60,\n"
+            "                             120, 144): exactly one coalesced frame per refresh.\n"
+            "                             Overrides --scheduler (default: off)\n"
+            "      --phase-offset-us INT  Frame phase on CLOCK_MONOTONIC in microseconds,\n"
+            "                             used with --refresh-hz (default: 0)\n"
             "      --low-rate FLOAT       Input rate (events/sec) below which no dampening\n"
             "                             is applied — full responsiveness (default: %.1f)\n"
             "      --high-rate FLOAT      Input rate (events/sec) above which maximum\n"
             "                             dampening is applied (default: %.1f)\n"
             "      --min-scale FLOAT      Scale factor at high input rate (default: %.2f)\n"
+            "      --curve CURVE          Dampening between --low-rate and --high-rate:\n"
+            "                             sqrt, linear, power:K, piecewise:T:D,T:D,... or\n"
+            "                             cubic:T:D,T:D,... (default: " DEFAULT_CURVE ")\n"
             "      --stop-threshold FLOAT Velocity below which scrolling stops (default: %.1f)\n"
             "  -m, --multiplier FLOAT     Global scroll distance multiplier (default: %.1f)\n"
             "                             Lower = less scroll per gesture. 0.3 for fine control,\n"
             "                             1.0 for full 1:1 passthrough.\n"
+            "      --rate-window-ms INT   Window over which the input rate is measured\n"
+            "                             (default: %d)\n"
+            "      --rate-ring-size INT   Most recent events kept per axis for the input\n"
+            "                             rate (default: %d)\n"
+            "      --fixed-point          Integer friction physics: the same event and tick\n"
+            "                             times give the same output (replayable)\n",
+            progname, DEFAULT_FRICTION, DEFAULT_SPRING_STIFFNESS,
+            DEFAULT_SPRING_MS, DEFAULT_REVERSAL_DAMP, DEFAULT_TICK_MS,
+            DEFAULT_LOW_RATE, DEFAULT_HIGH_RATE, DEFAULT_MIN_SCALE,
+            DEFAULT_STOP_THRESHOLD, DEFAULT_MULTIPLIER,
+            DEFAULT_RATE_WINDOW_MS, DEFAULT_RATE_RING_SIZE);
+    fprintf(stderr,
+            "      --realtime             Low-latency mode: SCHED_FIFO, mlockall, CPU pinning\n"
+            "                             and 1 ns timer slack (results are reported)\n"
+            "      --rt-priority INT      SCHED_FIFO priority for --realtime, 1-99 (default: %d)\n"
+            "      --cpu INT              Pin the daemon to this CPU with --realtime\n"
+            "      --match RULE           Auto-detection rule, repeatable: comma-separated\n"
+            "                             name=REGEX, vendor=HEX, product=HEX, bus=BUS,\n"
+            "                             phys=GLOB, caps=CODE+CODE, priority=INT, ignore\n"
+            "                             (default: '" DEFAULT_MATCH_RULE "')\n"
+            "      --config FILE          Read options from FILE, one 'name = value' per line;\n"
+            "                             re-read on SIGHUP, command-line options win\n"
+            "      --control-socket PATH  Accept list/get/set commands on this Unix socket\n"
+            "                             to tune the running daemon (e.g. /run/smooth-scroll.sock)\n"
             "  -v, --verbose              Print debug info about intercepted/emitted events\n"
             "  -h, --help                 Show this help\n",
-            progname, DEFAULT_FRICTION, DEFAULT_TICK_MS,
-            DEFAULT_LOW_RATE, DEFAULT_HIGH_RATE, DEFAULT_MIN_SCALE,
-            DEFAULT_STOP_THRESHOLD, DEFAULT_MULTIPLIER);
+            DEFAULT_RT_PRIORITY);
 }
 
-/* ── Main ─────────────────────────────────────────────────────────────── */
+/* ── Command line and config file ─────────────────────────────────────── */
 
-int main(int argc, char *argv[])
+/*
+ * Apply the command-line options on top of cfg.  Returns 0, 1 once
+ * --help has been shown, or -1 after printing the usage error.
+ */
+static int parse_args(struct config *cfg, int argc, char *argv[])
 {
-    struct config cfg = {
-        .friction = DEFAULT_FRICTION,
-        .tick_ms = DEFAULT_TICK_MS,
-        .low_rate = DEFAULT_LOW_RATE,
-        .high_rate = DEFAULT_HIGH_RATE,
-        .min_scale = DEFAULT_MIN_SCALE,
-        .stop_threshold = DEFAULT_STOP_THRESHOLD,
-        .multiplier = DEFAULT_MULTIPLIER,
-        .verbose = 0,
-        .device_path = NULL,
-    };
-
-    /* ── Parse command-line arguments ──────────────────────────────── */
-
+    /*
+     * Options backed by params[] return 'A' and are parsed and range
+     * checked by config_set(), exactly like the config file.
+     */
     static struct option long_opts[] = {
-        {"friction", required_argument, NULL, 'f'},
-        {"tick-ms", required_argument, NULL, 't'},
-        {"low-rate", required_argument, NULL, 'L'},
-        {"high-rate", required_argument, NULL, 'H'},
-        {"min-scale", required_argument, NULL, 'S'},
-        {"stop-threshold", required_argument, NULL, 'T'},
-        {"multiplier", required_argument, NULL, 'm'},
+        {"model", required_argument, NULL, 'A'},
+        {"friction", required_argument, NULL, 'A'},
+        {"spring-stiffness", required_argument, NULL, 'A'},
+        {"spring-ms", required_argument, NULL, 'A'},
+        {"reversal", required_argument, NULL, 'A'},
+        {"reversal-damp", required_argument, NULL, 'A'},
+        {"tick-ms", required_argument, NULL, 'A'},
+        {"scheduler", required_argument, NULL, 'A'},
+        {"refresh-hz", required_argument, NULL, 'A'},
+        {"phase-offset-us", required_argument, NULL, 'A'},
+        {"low-rate", required_argument, NULL, 'A'},
+        {"high-rate", required_argument, NULL, 'A'},
+        {"min-scale", required_argument, NULL, 'A'},
+        {"curve", required_argument, NULL, 'A'},
+        {"stop-threshold", required_argument, NULL, 'A'},
+        {"multiplier", required_argument, NULL, 'A'},
+        {"rate-window-ms", required_argument, NULL, 'A'},
+        {"rate-ring-size", required_argument, NULL, 'A'},
+        {"fixed-point", no_argument, NULL, 'I'},
+        {"realtime", no_argument, NULL, 'F'},
+        {"rt-priority", required_argument, NULL, 'A'},
+        {"cpu", required_argument, NULL, 'A'},
+        {"match", required_argument, NULL, 'M'},
+        {"control-socket", required_argument, NULL, 'A'},
+        {"config", required_argument, NULL, 'G'},
         {"verbose", no_argument, NULL, 'v'},
         {"help", no_argument, NULL, 'h'},
+        {"h-model", required_argument, NULL, 'A'},
+        {"h-friction", required_argument, NULL, 'A'},
+        {"h-spring-stiffness", required_argument, NULL, 'A'},
+        {"h-spring-ms", required_argument, NULL, 'A'},
+        {"h-reversal", required_argument, NULL, 'A'},
+        {"h-reversal-damp", required_argument, NULL, 'A'},
+        {"h-low-rate", required_argument, NULL, 'A'},
+        {"h-high-rate", required_argument, NULL, 'A'},
+        {"h-min-scale", required_argument, NULL, 'A'},
+        {"h-curve", required_argument, NULL, 'A'},
+        {"h-stop-threshold", required_argument, NULL, 'A'},
+        {"h-multiplier", required_argument, NULL, 'A'},
         {NULL, 0, NULL, 0}};
 
-    int opt;
-    while ((opt = getopt_long(argc, argv, "f:t:m:vh", long_opts, NULL)) != -1)
+    char err[256];
+    int cli_rules = 0;
+    int opt, index;
+
+    optind = 0; /* parsed again on every reload */
+    while ((opt = getopt_long(argc, argv, "f:t:m:vh", long_opts, &index)) !=
+           -1)
     {
+        const char *name = NULL;
+
         switch (opt)
         {
+        case 'A':
+            name = long_opts[index].name;
+            break;
         case 'f':
-            cfg.friction = atof(optarg);
+            name = "friction";
             break;
         case 't':
-            cfg.tick_ms = atoi(optarg);
+            name = "tick-ms";
             break;
-        case 'L':
-            cfg.low_rate = atof(optarg);
+        case 'm':
+            name = "multiplier";
             break;
-        case 'H':
-            cfg.high_rate = atof(optarg);
+        case 'F':
+            cfg->realtime = 1;
             break;
-        case 'S':
-            cfg.min_scale = atof(optarg);
+        case 'I':
+            cfg->fixed_point = 1;
             break;
-        case 'T':
-            cfg.stop_threshold = atof(optarg);
+        case 'M':
+            /* Rules on the command line replace those from the file. */
+            if (!cli_rules++)
+            {
+                match_free_all(cfg->rules, cfg->nrules);
+                cfg->rules = NULL;
+                cfg->nrules = 0;
+            }
+            name = "match";
             break;
-        case 'm':
-            cfg.multiplier = atof(optarg);
+        case 'G':
+            cfg->config_path = optarg;
             break;
         case 'v':
-            cfg.verbose = 1;
+            cfg->verbose = 1;
             break;
         case 'h':
             print_usage(argv[0]);
-            return 0;
+            return 1;
         default:
             print_usage(argv[0]);
-            return 1;
+            return -1;
+        }
+
+        if (name &&
+            config_set(cfg, param_find(name), optarg, err, sizeof(err)) < 0)
+        {
+            fprintf(stderr, "%s\n", err);
+            print_usage(argv[0]);
+            return -1;
         }
     }
 
-    /* Non-option argument is the device path. */
+    /* Non-option arguments are device paths; they replace the file's. */
     if (optind < argc)
-        cfg.device_path = argv[optind];
-
-    /* Clamp configuration to sane ranges. */
-    if (cfg.friction < 0.01)
-        cfg.friction = 0.01;
-    if (cfg.friction > 0.2)
-        cfg.friction = 0.2;
-    if (cfg.tick_ms < 1)
-        cfg.tick_ms = 1;
-    if (cfg.tick_ms > 50)
-        cfg.tick_ms = 50;
-    if (cfg.multiplier < 0.01)
-        cfg.multiplier = 0.01;
-    if (cfg.multiplier > 10.0)
-        cfg.multiplier = 10.0;
-
-    /* ── Install signal handlers ──────────────────────────────────── */
+        cfg->ndevice_paths = 0;
+    for (int i = optind; i < argc; i++)
+    {
+        if (config_set(cfg, param_find("device"), argv[i], err,
+                       sizeof(err)) < 0)
+        {
+            fprintf(stderr, "%s\n", err);
+            return -1;
+        }
+    }
+    return 0;
+}
 
-    struct sigaction sa;
-    memset(&sa, 0, sizeof(sa));
-    sa.sa_handler = signal_handler;
-    sigaction(SIGINT, &sa, NULL);
-    sigaction(SIGTERM, &sa, NULL);
+/*
+ * Read a --config file: one "name = value" per line, using the long
+ * option names.  A bare boolean name means on; match and device may be
+ * repeated; lines starting with '#' are comments.
+ */
+static int config_load(struct config *cfg, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+    {
+        perror(path);
+        return -1;
+    }
 
-    /* ── Open source device ───────────────────────────────────────── */
+    char line[1024], err[256];
+    int lineno = 0, rc = 0;
+    while (rc == 0 && fgets(line, sizeof(line), f))
+    {
+        lineno++;
+        char *end = line + strlen(line);
+        while (end > line && isspace((unsigned char)end[-1]))
+            *--end = '\0';
+        char *key = line + strspn(line, " \t");
+        if (!*key || *key == '#')
+            continue;
 
-    char *auto_path = NULL;
-    const char *dev_path = cfg.device_path;
+        char *value = strchr(key, '=');
+        if (value)
+        {
+            end = value;
+            *value++ = '\0';
+            value += strspn(value, " \t");
+            while (end > key && isspace((unsigned char)end[-1]))
+                *--end = '\0';
+        }
 
-    if (!dev_path)
-    {
-        auto_path = find_scroll_device();
-        if (!auto_path)
+        const struct param *p = param_find(key);
+        if (!p)
         {
-            fprintf(stderr,
-                    "Error: No SPICE/QEMU/VirtIO scroll device found.\n"
-                    "Provide a device path: %s /dev/input/eventN\n"
-                    "List devices with: cat /proc/bus/input/devices\n",
-                    argv[0]);
-            return 1;
+            snprintf(err, sizeof(err), "unknown setting '%s'", key);
+            rc = -1;
         }
-        dev_path = auto_path;
+        else if (!value && p->type != PARAM_BOOL)
+        {
+            snprintf(err, sizeof(err), "expected '%s = VALUE'", key);
+            rc = -1;
+        }
+        else
+            rc = config_set(cfg, p, value ? value : "on", err, sizeof(err));
+
+        if (rc < 0)
+            fprintf(stderr, "%s:%d: %s\n", path, lineno, err);
     }
+    fclose(f);
+    return rc;
+}
 
-    int src_fd = open(dev_path, O_RDONLY | O_NONBLOCK);
-    if (src_fd < 0)
+/*
+ * Build the configuration from its layers: built-in defaults, then the
+ * --config file, then the command line, which wins.  Returns 0, 1 once
+ * --help has been shown, or -1 on error.
+ */
+static int config_build(struct config *cfg, int argc, char *argv[])
+{
+    /* A first pass over the command line finds the file. */
+    config_defaults(cfg);
+    int rc = parse_args(cfg, argc, argv);
+    const char *file = cfg->config_path;
+
+    if (rc == 0 && file)
     {
-        fprintf(stderr, "open %s: %s\n", dev_path, strerror(errno));
-        free(auto_path);
-        return 1;
+        match_free_all(cfg->rules, cfg->nrules);
+        config_defaults(cfg);
+        cfg->config_path = file;
+        rc = config_load(cfg, file);
+        if (rc == 0)
+            rc = parse_args(cfg, argc, argv);
     }
+    if (rc == 0 && config_finish(cfg) < 0)
+        rc = -1;
 
-    /* Initialize libevdev from the source device fd. */
-    struct libevdev *evdev = NULL;
-    int rc = libevdev_new_from_fd(src_fd, &evdev);
-    if (rc < 0)
+    if (rc != 0)
     {
-        fprintf(stderr, "libevdev_new_from_fd: %s\n", strerror(-rc));
-        close(src_fd);
-        free(auto_path);
-        return 1;
+        match_free_all(cfg->rules, cfg->nrules);
+        cfg->rules = NULL;
+        cfg->nrules = 0;
     }
+    return rc;
+}
 
-    fprintf(stderr, "Source device: %s (%s)\n",
-            dev_path, libevdev_get_name(evdev));
+/*
+ * SIGHUP: rebuild the configuration from scratch and swap it in.  The
+ * devices, their virtual devices, glides and rate history carry over;
+ * the settings only read at startup keep their running values.
+ */
+static void config_reload(struct engine *eng, int argc, char *argv[])
+{
+    struct config next;
+    const struct config *cfg = eng->cfg;
+
+    if (config_build(&next, argc, argv) != 0)
+    {
+        fprintf(stderr, "Reload failed, configuration unchanged.\n");
+        return;
+    }
 
-    /* ── Create uinput virtual device ─────────────────────────────── */
+    int same_devices = next.ndevice_paths == cfg->ndevice_paths;
+    for (int i = 0; same_devices && i < cfg->ndevice_paths; i++)
+        same_devices = !strcmp(next.device_paths[i], cfg->device_paths[i]);
+    if (!same_devices || strcmp(next.control_path, cfg->control_path) != 0)
+        fprintf(stderr, "Device paths and the control socket only change "
+                        "on restart.\n");
+    memcpy(next.device_paths, cfg->device_paths, sizeof(next.device_paths));
+    next.ndevice_paths = cfg->ndevice_paths;
+    memcpy(next.control_path, cfg->control_path, sizeof(next.control_path));
+
+    engine_apply_config(eng, &next);
+    fprintf(stderr, "Reloaded configuration%s%s.\n",
+            cfg->config_path ? " from " : "",
+            cfg->config_path ? cfg->config_path : "");
+}
 
-    int uifd = create_uinput_device(evdev);
-    if (uifd < 0)
+/*
+ * Drain the signalfd: SIGUSR1 prints statistics at once.  Returns 1 if
+ * SIGHUP was among the signals, so the caller reloads once.
+ */
+static int signal_read(struct engine *eng)
+{
+    struct signalfd_siginfo si;
+    int hup = 0;
+    while (read(eng->sfd, &si, sizeof(si)) == (ssize_t)sizeof(si))
     {
-        libevdev_free(evdev);
-        close(src_fd);
-        free(auto_path);
-        return 1;
+        if (si.ssi_signo == SIGUSR1)
+            print_stats(eng);
+        hup |= si.ssi_signo == SIGHUP;
     }
+    return hup;
+}
+
+/* ── Main ─────────────────────────────────────────────────────────────── */
+
+int main(int argc, char *argv[])
+{
+    struct config cfg;
+    int rc = config_build(&cfg, argc, argv);
+    if (rc != 0)
+        return rc < 0 ? 1 : 0;
+    int default_rules = cfg.nrules == 1 &&
+                        strcmp(cfg.rules[0].text, DEFAULT_MATCH_RULE) == 0;
+
+    /* ── Install signal handlers ──────────────────────────────────── */
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = signal_handler;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
 
     /*
-     * Small delay to let udev/libinput recognize the new virtual device
-     * before we grab the source and it goes silent.
+     * SIGHUP and SIGUSR1 are read from a signalfd in the event loop
+     * instead, so they are handled even while the loop is busy.
      */
-    usleep(200000);
+    sigset_t sigs;
+    sigemptyset(&sigs);
+    sigaddset(&sigs, SIGHUP);
+    sigaddset(&sigs, SIGUSR1);
+    sigprocmask(SIG_BLOCK, &sigs, NULL);
 
-    /* ── Grab source device ───────────────────────────────────────── */
+    /* ── Create timer fd ──────────────────────────────────────────── */
 
-    if (ioctl(src_fd, EVIOCGRAB, 1) < 0)
+    struct engine eng;
+    memset(&eng, 0, sizeof(eng));
+    eng.cfg = &cfg;
+    eng.epfd = -1;
+    eng.timer_w.kind = WATCH_TIMER;
+    eng.hotplug_w.kind = WATCH_HOTPLUG;
+    eng.hotplug.fd = -1;
+    eng.control_w.kind = WATCH_CONTROL;
+    eng.control_fd = -1;
+    eng.signal_w.kind = WATCH_SIGNAL;
+    eng.sfd = -1;
+    eng.ready_w.kind = WATCH_READY;
+    eng.ready_tfd = -1;
+    int status = 1;
+
+    /* Already checked while parsing, so this cannot fail. */
+    char err[256];
+    for (int a = 0; a < AXIS_COUNT; a++)
     {
-        perror("EVIOCGRAB");
-        ioctl(uifd, UI_DEV_DESTROY);
-        close(uifd);
-        libevdev_free(evdev);
-        close(src_fd);
-        free(auto_path);
-        return 1;
+        if (curve_compile(&eng.curves[a][0], cfg.axis[a].curve, err,
+                          sizeof(err)) < 0)
+        {
+            fprintf(stderr, "%s\n", err);
+            return 1;
+        }
+        eng.curve[a] = &eng.curves[a][0];
     }
 
-    fprintf(stderr, "Grabbed source device. Scroll smoothing active.\n");
-
-    /* ── Create timer fd ──────────────────────────────────────────── */
-
-    int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
-    if (tfd < 0)
+    eng.tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    if (eng.tfd < 0)
     {
         perror("timerfd_create");
-        goto cleanup;
+        return 1;
     }
 
     /*
      * Use TFD_TIMER_ABSTIME with absolute scheduling to prevent timer drift.
      * Each tick is scheduled as an absolute time (previous + interval) rather
-     * than relative, ensuring precise 125 Hz emission without drift accumulation.
+     * than relative, ensuring precise emission without drift accumulation.
+     *
+     * The timer starts disarmed: it is only armed while a device has an
+     * axis with velocity.  The fixed scheduler keeps it on the grid
+     * anchored at startup; the tickless one arms it for the next due
+     * hi-res unit; the refresh one arms it ahead of each display frame
+     * (next_tick_ns then holds the frame time, not the arm time).
      */
-    long tick_ns = cfg.tick_ms * 1000000L;
-    struct timespec ts_now;
-    clock_gettime(CLOCK_MONOTONIC, &ts_now);
+    eng.tick_ns = cfg.tick_ms * 1000000LL;
 
     /* next_tick tracks the absolute time of the next scheduled tick. */
-    int64_t next_tick_ns = (int64_t)ts_now.tv_sec * 1000000000LL +
-                           ts_now.tv_nsec + tick_ns;
+    eng.next_tick_ns = now_ns();
+
+    if (cfg.scheduler == SCHEDULER_REFRESH)
+        pll_init(&eng.pll, &cfg);
+
+    eng.wstats.start_ns = eng.next_tick_ns;
+    eng.wstats.window_start_ns = eng.next_tick_ns;
+    eng.wstats.idle_since_ns = eng.next_tick_ns;
+
+    /* ── Set up epoll ─────────────────────────────────────────────── */
+
+    eng.epfd = epoll_create1(0);
+    if (eng.epfd < 0)
+    {
+        perror("epoll_create1");
+        goto cleanup;
+    }
 
     {
-        struct itimerspec its;
-        memset(&its, 0, sizeof(its));
-        its.it_value.tv_sec = (time_t)(next_tick_ns / 1000000000LL);
-        its.it_value.tv_nsec = (long)(next_tick_ns % 1000000000LL);
-        /* No interval — we reschedule each tick as an absolute time. */
-        its.it_interval.tv_sec = 0;
-        its.it_interval.tv_nsec = 0;
-        if (timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL) < 0)
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = &eng.timer_w;
+        if (epoll_ctl(eng.epfd, EPOLL_CTL_ADD, eng.tfd, &ev) < 0)
         {
-            perror("timerfd_settime");
-            close(tfd);
+            perror("epoll_ctl tfd");
             goto cleanup;
         }
     }
 
-    /* ── Set up epoll ─────────────────────────────────────────────── */
+    /*
+     * Without the hotplug watcher a lost source is dropped, and losing
+     * the last one ends the daemon so systemd restarts it, as before.
+     */
+    if (hotplug_init(&eng.hotplug) == 0)
+    {
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = &eng.hotplug_w;
+        if (epoll_ctl(eng.epfd, EPOLL_CTL_ADD, eng.hotplug.fd, &ev) < 0)
+        {
+            perror("epoll_ctl inotify");
+            close(eng.hotplug.fd);
+            eng.hotplug.fd = -1;
+        }
+    }
 
-    int epfd = epoll_create1(0);
-    if (epfd < 0)
+    eng.sfd = signalfd(-1, &sigs, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (eng.sfd < 0)
     {
-        perror("epoll_create1");
-        close(tfd);
+        perror("signalfd");
         goto cleanup;
     }
-
     {
         struct epoll_event ev;
-
         ev.events = EPOLLIN;
-        ev.data.fd = src_fd;
-        if (epoll_ctl(epfd, EPOLL_CTL_ADD, src_fd, &ev) < 0)
+        ev.data.ptr = &eng.signal_w;
+        if (epoll_ctl(eng.epfd, EPOLL_CTL_ADD, eng.sfd, &ev) < 0)
         {
-            perror("epoll_ctl src_fd");
-            close(epfd);
-            close(tfd);
+            perror("epoll_ctl signalfd");
             goto cleanup;
         }
+    }
 
+    /* Deadline for sources waiting on udev once the loop runs. */
+    eng.ready_tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    if (eng.ready_tfd < 0)
+    {
+        perror("timerfd_create");
+        goto cleanup;
+    }
+    {
+        struct epoll_event ev;
         ev.events = EPOLLIN;
-        ev.data.fd = tfd;
-        if (epoll_ctl(epfd, EPOLL_CTL_ADD, tfd, &ev) < 0)
+        ev.data.ptr = &eng.ready_w;
+        if (epoll_ctl(eng.epfd, EPOLL_CTL_ADD, eng.ready_tfd, &ev) < 0)
         {
-            perror("epoll_ctl tfd");
-            close(epfd);
-            close(tfd);
+            perror("epoll_ctl ready_tfd");
             goto cleanup;
         }
     }
 
-    /* ── Scroll state ─────────────────────────────────────────────── */
+    if (cfg.control_path[0] && control_open(&eng, cfg.control_path) < 0)
+        goto cleanup;
 
-    struct axis_state vert = {0};
-    struct axis_state horiz = {0};
+    /* ── Open and grab source devices ─────────────────────────────── */
 
     /*
-     * Track whether we forwarded any non-scroll events in the current
-     * frame.  We suppress SYN_REPORT after scroll-only frames so we
-     * don't emit empty syncs.
+     * Each source gets its own uinput virtual device, created before the
+     * source is grabbed so input never goes dark.
      */
-    int had_non_scroll = 0;
+    if (cfg.ndevice_paths)
+    {
+        for (int i = 0; i < cfg.ndevice_paths; i++)
+        {
+            const char *path = cfg.device_paths[i];
+            struct device *dev = engine_add(&eng, path);
+            if (!dev || engine_acquire(&eng, dev, path) < 0)
+                goto cleanup;
+        }
+    }
+    else if (engine_scan(&eng) == 0)
+    {
+        fprintf(stderr,
+                "Error: No %s found.\n"
+                "Provide a device path: %s /dev/input/eventN\n"
+                "List devices with: cat /proc/bus/input/devices\n",
+                default_rules ? "SPICE/QEMU/VirtIO scroll device"
+                              : "device matching the --match rules",
+                argv[0]);
+        goto cleanup;
+    }
+
+    fprintf(stderr, "Grabbed %d source device%s. Scroll smoothing active.\n",
+            eng.ndevices, eng.ndevices == 1 ? "" : "s");
+
+    if (cfg.realtime)
+        enter_realtime(&cfg);
 
     /* ── Main event loop ──────────────────────────────────────────── */
 
-    struct epoll_event events[2];
+    /* From here on, new virtual devices are waited for without blocking. */
+    eng.live = 1;
+    struct epoll_event events[MAX_DEVICES + CONTROL_MAX_CLIENTS + 4];
+    int maxevents = (int)(sizeof(events) / sizeof(events[0]));
 
     while (g_running)
     {
-        int nfds = epoll_wait(epfd, events, 2, -1);
+        int nfds = epoll_wait(eng.epfd, events, maxevents, -1);
         if (nfds < 0)
         {
+            /* Interrupted by signal — recheck g_running. */
             if (errno == EINTR)
-                continue; /* interrupted by signal — recheck g_running */
+                continue;
             perror("epoll_wait");
             break;
         }
 
+        eng.wstats.total++;
+        if (cfg.verbose)
+        {
+            int64_t now = now_ns();
+            eng.wstats.window_total++;
+            if (now - eng.wstats.window_start_ns >= WAKEUP_REPORT_NS)
+                wakeup_report(&eng.wstats, now);
+        }
+
         for (int i = 0; i < nfds; i++)
         {
-            int fd = events[i].data.fd;
+            struct watch *w = events[i].data.ptr;
 
-            /* ── Source device readable ────────────────────────── */
-            if (fd == src_fd)
+            switch (w->kind)
             {
-                struct input_event ev;
-                while (1)
-                {
-                    ssize_t n = read(src_fd, &ev, sizeof(ev));
-                    if (n < 0)
-                    {
-                        if (errno == EAGAIN || errno == EWOULDBLOCK)
-                            break;
-                        /* Device gone (hot-unplug). */
-                        fprintf(stderr,
-                                "Source device read error: %s\n",
-                                strerror(errno));
-                        g_running = 0;
-                        g_device_error = 1;
-                        break;
-                    }
-                    if (n == 0)
-                    {
-                        fprintf(stderr, "Source device EOF.\n");
-                        g_running = 0;
-                        g_device_error = 1;
-                        break;
-                    }
-                    if (n != sizeof(ev))
-                        continue;
+            /* ── Source device readable ──────────────────────────── */
+            case WATCH_DEVICE:
+                if (!((struct device *)w)->dead)
+                    device_read(&eng, (struct device *)w);
+                break;
 
-                    /* SYN_REPORT: flush only if we forwarded non-scroll. */
-                    if (ev.type == EV_SYN && ev.code == SYN_REPORT)
-                    {
-                        if (had_non_scroll)
-                        {
-                            write_syn(uifd);
-                        }
-                        had_non_scroll = 0;
-                        continue;
-                    }
+            /* ── /dev/input changed: devices came or went ────────── */
+            case WATCH_HOTPLUG:
+                engine_hotplug(&eng);
+                break;
 
-                    /* Intercept scroll events. */
-                    if (ev.type == EV_REL && is_scroll_code(ev.code))
-                    {
-                        int64_t ts = now_ns();
-                        double raw = 0.0;
-                        struct axis_state *axis = NULL;
-
-                        switch (ev.code)
-                        {
-                        case REL_WHEEL:
-                            raw = (double)ev.value * HIRES_PER_TICK;
-                            axis = &vert;
-                            break;
-                        case REL_HWHEEL:
-                            raw = (double)ev.value * HIRES_PER_TICK;
-                            axis = &horiz;
-                            break;
-                        case REL_WHEEL_HI_RES:
-                            raw = (double)ev.value;
-                            axis = &vert;
-                            break;
-                        case REL_HWHEEL_HI_RES:
-                            raw = (double)ev.value;
-                            axis = &horiz;
-                            break;
-                        }
-
-                        if (axis)
-                        {
-                            rate_record(&axis->rate, ts);
-                            double rate = rate_compute(&axis->rate, ts);
-                            double scale = compute_scale(rate, &cfg);
-                            axis->velocity += raw * scale * cfg.multiplier;
-
-                            if (cfg.verbose)
-                            {
-                                fprintf(stderr,
-                                        "[in] code=%u val=%d raw=%.0f "
-                                        "rate=%.1f/s scale=%.3f vel=%.1f\n",
-                                        ev.code, ev.value, raw,
-                                        rate, scale, axis->velocity);
-                            }
-
-                            /*
-                             * Emit immediately on new input for sharp
-                             * initial response.  Without this, the first
-                             * scroll impulse waits up to one tick interval
-                             * before anything appears on screen, making the
-                             * start of a scroll feel soft/laggy compared to
-                             * native macOS.  The timer continues handling
-                             * the deceleration coast.
-                             *
-                             * If emit_axis returns 0 (friction extract < 1
-                             * hi-res unit), force-emit ±1 so that every
-                             * scroll input — no matter how small — produces
-                             * immediate visible feedback.  This is critical
-                             * for very slow, precise trackpad scrolling
-                             * where the host sends tiny scroll deltas.
-                             */
-                            unsigned short hc =
-                                (axis == &vert) ? REL_WHEEL_HI_RES
-                                                : REL_HWHEEL_HI_RES;
-                            const char *lbl =
-                                (axis == &vert) ? "vert" : "horiz";
-                            int did_emit =
-                                emit_axis(uifd, axis, hc, &cfg, lbl);
-
-                            /*
-                             * If emit_axis produced nothing (friction
-                             * extract < 1 hi-res unit), force-emit ±1 so
-                             * every scroll input — no matter how small —
-                             * produces immediate visible feedback.  Critical
-                             * for very slow, precise trackpad scrolling.
-                             */
-                            if (!did_emit &&
-                                fabs(axis->velocity) >= cfg.stop_threshold)
-                            {
-                                int dir =
-                                    (axis->velocity > 0) ? 1 : -1;
-                                write_event(uifd, EV_REL, hc, dir);
-                                axis->lowres_accum += dir;
-                                axis->velocity -= (double)dir;
-                                axis->emit_accum = 0.0;
-                                did_emit = 1;
-
-                                if (cfg.verbose)
-                                {
-                                    fprintf(stderr,
-                                            "[emit] %s hires=%d (min) "
-                                            "vel=%.1f\n",
-                                            lbl, dir, axis->velocity);
-                                }
-                            }
-
-                            if (did_emit)
-                                write_syn(uifd);
-                        }
-
-                        continue;
-                    }
+            /* ── Timer tick: emit smooth scroll ──────────────────── */
+            case WATCH_TIMER:
+                engine_tick(&eng);
+                break;
 
-                    /* Forward all other events immediately. */
-                    write_event(uifd, ev.type, ev.code, ev.value);
-                    had_non_scroll = 1;
-                }
-            }
+            /* ── Control socket: new connection or command ───────── */
+            case WATCH_CONTROL:
+                control_accept(&eng);
+                break;
 
-            /* ── Timer tick: emit smooth scroll ───────────────── */
-            if (fd == tfd)
-            {
-                uint64_t expirations;
-                ssize_t n = read(tfd, &expirations, sizeof(expirations));
-                if (n < 0 && errno != EAGAIN)
-                {
-                    perror("read timerfd");
-                    continue;
-                }
+            case WATCH_CLIENT:
+                control_read(&eng, (struct control_client *)w);
+                break;
 
-                /* Reschedule the next tick as an absolute time. */
-                next_tick_ns += tick_ns;
-                {
-                    struct itimerspec its;
-                    memset(&its, 0, sizeof(its));
-                    its.it_value.tv_sec =
-                        (time_t)(next_tick_ns / 1000000000LL);
-                    its.it_value.tv_nsec =
-                        (long)(next_tick_ns % 1000000000LL);
-                    timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL);
-                }
+            /* ── SIGUSR1: statistics; SIGHUP: reload ─────────────── */
+            case WATCH_SIGNAL:
+                if (signal_read(&eng))
+                    config_reload(&eng, argc, argv);
+                break;
 
-                int emitted = 0;
-                emitted |= emit_axis(uifd, &vert, REL_WHEEL_HI_RES,
-                                     &cfg, "vert");
-                emitted |= emit_axis(uifd, &horiz, REL_HWHEEL_HI_RES,
-                                     &cfg, "horiz");
-                if (emitted)
-                    write_syn(uifd);
+            /* ── A pending source waited long enough for udev ────── */
+            case WATCH_READY:
+                engine_ready_check(&eng);
+                break;
             }
         }
+
+        /* Nothing in this batch can point at a removed device any more. */
+        engine_reap(&eng);
     }
 
     /* ── Cleanup ──────────────────────────────────────────────────── */
 
     fprintf(stderr, "\nShutting down...\n");
-
-    close(epfd);
-    close(tfd);
+    print_stats(&eng);
+    status = g_device_error ? 1 : 0;
 
 cleanup:
-    /* Ungrab source device so it becomes usable again. */
-    ioctl(src_fd, EVIOCGRAB, 0);
-
-    /* Destroy the virtual device. */
-    ioctl(uifd, UI_DEV_DESTROY);
-    close(uifd);
-
-    libevdev_free(evdev);
-    close(src_fd);
-    free(auto_path);
+    /* Ungrab every source and destroy its virtual device. */
+    for (int i = 0; i < eng.ndevices; i++)
+        device_free(eng.devices[i]);
+    engine_reap(&eng);
+
+    control_close(&eng);
+    if (eng.sfd >= 0)
+        close(eng.sfd);
+    if (eng.ready_tfd >= 0)
+        close(eng.ready_tfd);
+    if (eng.hotplug.fd >= 0)
+        close(eng.hotplug.fd);
+    if (eng.epfd >= 0)
+        close(eng.epfd);
+    close(eng.tfd);
+
+    match_free_all(cfg.rules, cfg.nrules);
 
     fprintf(stderr, "Cleanup complete.\n");
-    return g_device_error ? 1 : 0;
+    return status;
 }